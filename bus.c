@@ -0,0 +1,484 @@
+#include "bus.h"
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include <hardware/i2c.h>
+#include <pico/i2c_slave.h>
+#include "hardware/dma.h"
+#include "csr.h"
+#include "doorbell.h"
+#include "hot.h"
+#include "latency.h"
+#include "power.h"
+#include "trace.h"
+
+static const uint I2C_SLAVE_ADDRESS = 050 ; // 0x28
+static const uint I2C_BAUDRATE = 100000 ;  // 100 kHz
+static uint baud_hz = 0 ;                  // as set up for the current clk_sys
+static const uint I2C_SLAVE_SDA_PIN = PICO_DEFAULT_I2C_SDA_PIN ; // 4
+static const uint I2C_SLAVE_SCL_PIN = PICO_DEFAULT_I2C_SCL_PIN ; // 5
+static const uint32_t I2C_BYTE_TIMEOUT_US = 1000 ; // ~10 byte times at 100 kHz
+static const uint32_t I2C_STUCK_TIMEOUT_US = 50000 ;
+static const uint32_t I2C_STUCK_BACKOFF_MAX_US = 1600000 ; // re-init interval while a line stays low
+
+#define BUS_TX_MAX (2 * CSR_BURST_MAX + 3)
+#define BUS_TX_FIFO_MAX 8
+#define BUS_TX_FIFO_DEPTH 16
+
+#if BUS_STRETCH_TIMEOUT_US >= 50000
+#error BUS_STRETCH_TIMEOUT_US must stay below the stuck bus timeout
+#endif
+
+static struct {
+    uint8_t addr ;  // without BUS_FRAMED
+    uint16_t value ;
+    uint8_t seq ;
+    bool framed ;
+    bool valid ;    // addr (and value) fully received
+    bool pending ;  // write not yet acknowledged by a read
+    bool nak ;      // framed request failed its CRC
+    bool replay ;   // framed request repeats the last seq
+    bool busy ;     // stretched read timed out, answered without reading
+} context ;
+
+// last framed response, still in tx, replayed when the host retries the same seq
+static struct {
+    uint8_t addr ;
+    uint8_t seq ;
+    bool valid ;
+} last ;
+
+// Response buffer. Entries are halfwords because the DMA writes them straight
+// into IC_DATA_CMD, where a byte-replicated 8-bit write would set the CMD bits.
+static struct {
+    uint16_t buf[BUS_TX_MAX] ;
+    uint8_t len ;
+    uint8_t crc ;
+    int dma ;
+    dma_channel_config cfg ;
+} tx ;
+
+static struct {
+    uint32_t timeouts ;     // frame cut short, dropped
+    uint32_t restarts ;     // new frame before the previous write was acknowledged
+    uint32_t stale ;        // read request without a valid frame
+    uint32_t crc ;          // framed request NAK'd
+    uint32_t replays ;      // framed request retried
+    uint32_t stuck_scl ;
+    uint32_t stuck_sda ;
+    uint32_t recoveries ;
+} bus_errors ;
+
+static volatile uint32_t bus_events = 0 ;
+static volatile uint32_t bus_last_us = 0 ;
+static uint32_t handler_max_us = 0 ;
+
+// read held with SCL low until the register is ready
+static struct {
+    volatile bool active ;
+    uint32_t since ;
+    uint32_t count ;
+    uint32_t timeouts ;
+} stretch ;
+
+static const uint8_t HOT_DATA crc8_table[256] = {
+    0x00, 0x07, 0x0e, 0x09, 0x1c, 0x1b, 0x12, 0x15, 0x38, 0x3f, 0x36, 0x31, 0x24, 0x23, 0x2a, 0x2d,
+    0x70, 0x77, 0x7e, 0x79, 0x6c, 0x6b, 0x62, 0x65, 0x48, 0x4f, 0x46, 0x41, 0x54, 0x53, 0x5a, 0x5d,
+    0xe0, 0xe7, 0xee, 0xe9, 0xfc, 0xfb, 0xf2, 0xf5, 0xd8, 0xdf, 0xd6, 0xd1, 0xc4, 0xc3, 0xca, 0xcd,
+    0x90, 0x97, 0x9e, 0x99, 0x8c, 0x8b, 0x82, 0x85, 0xa8, 0xaf, 0xa6, 0xa1, 0xb4, 0xb3, 0xba, 0xbd,
+    0xc7, 0xc0, 0xc9, 0xce, 0xdb, 0xdc, 0xd5, 0xd2, 0xff, 0xf8, 0xf1, 0xf6, 0xe3, 0xe4, 0xed, 0xea,
+    0xb7, 0xb0, 0xb9, 0xbe, 0xab, 0xac, 0xa5, 0xa2, 0x8f, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9d, 0x9a,
+    0x27, 0x20, 0x29, 0x2e, 0x3b, 0x3c, 0x35, 0x32, 0x1f, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0d, 0x0a,
+    0x57, 0x50, 0x59, 0x5e, 0x4b, 0x4c, 0x45, 0x42, 0x6f, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7d, 0x7a,
+    0x89, 0x8e, 0x87, 0x80, 0x95, 0x92, 0x9b, 0x9c, 0xb1, 0xb6, 0xbf, 0xb8, 0xad, 0xaa, 0xa3, 0xa4,
+    0xf9, 0xfe, 0xf7, 0xf0, 0xe5, 0xe2, 0xeb, 0xec, 0xc1, 0xc6, 0xcf, 0xc8, 0xdd, 0xda, 0xd3, 0xd4,
+    0x69, 0x6e, 0x67, 0x60, 0x75, 0x72, 0x7b, 0x7c, 0x51, 0x56, 0x5f, 0x58, 0x4d, 0x4a, 0x43, 0x44,
+    0x19, 0x1e, 0x17, 0x10, 0x05, 0x02, 0x0b, 0x0c, 0x21, 0x26, 0x2f, 0x28, 0x3d, 0x3a, 0x33, 0x34,
+    0x4e, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5c, 0x5b, 0x76, 0x71, 0x78, 0x7f, 0x6a, 0x6d, 0x64, 0x63,
+    0x3e, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2c, 0x2b, 0x06, 0x01, 0x08, 0x0f, 0x1a, 0x1d, 0x14, 0x13,
+    0xae, 0xa9, 0xa0, 0xa7, 0xb2, 0xb5, 0xbc, 0xbb, 0x96, 0x91, 0x98, 0x9f, 0x8a, 0x8d, 0x84, 0x83,
+    0xde, 0xd9, 0xd0, 0xd7, 0xc2, 0xc5, 0xcc, 0xcb, 0xe6, 0xe1, 0xe8, 0xef, 0xfa, 0xfd, 0xf4, 0xf3,
+} ;
+
+static uint8_t HOT_FUNC(crc8)(const uint8_t *b, uint8_t len) {
+    uint8_t crc = 0 ;
+    while (len--) {
+        crc = crc8_table[crc ^ *b++] ;
+    }
+    return crc ;
+}
+
+// a register write or reset may have queued device work
+static void HOT_FUNC(bus_wake_device)() {
+    latency_event_mark() ;
+    doorbell_ring(BUS_CORE, DOORBELL_DEVICE) ;
+}
+
+static void HOT_FUNC(tx_put)(uint8_t b) {
+    if (tx.len < BUS_TX_MAX) {
+        tx.buf[tx.len++] = b ;
+        tx.crc = crc8_table[tx.crc ^ b] ;
+    }
+}
+
+// Short responses fit the 16 entry TX FIFO and are cheaper to push directly,
+// longer ones are paced into the FIFO by DMA on the I2C TX DREQ so the IRQ
+// costs the same whatever the length.
+static void HOT_FUNC(i2c_send)(i2c_inst_t *i2c) {
+    if (tx.len <= BUS_TX_FIFO_MAX || tx.dma < 0) {
+        for (uint8_t n = 0; n < tx.len && n < BUS_TX_FIFO_DEPTH; n++) {
+            i2c_write_byte_raw(i2c, (uint8_t)tx.buf[n]) ;
+        }
+        return ;
+    }
+
+    if (dma_channel_is_busy(tx.dma)) {
+        dma_channel_abort(tx.dma) ;
+    }
+    dma_channel_configure(tx.dma, &tx.cfg, &i2c_get_hw(i2c)->data_cmd, tx.buf, tx.len, true) ;
+}
+
+static void i2c_tx_dma_init(i2c_inst_t *i2c) {
+    tx.dma = dma_claim_unused_channel(false) ;
+    if (tx.dma < 0) {
+        return ; // fall back to FIFO writes, bursts are refused
+    }
+
+    tx.cfg = dma_channel_get_default_config(tx.dma) ;
+    channel_config_set_transfer_data_size(&tx.cfg, DMA_SIZE_16) ;
+    channel_config_set_read_increment(&tx.cfg, true) ;
+    channel_config_set_write_increment(&tx.cfg, false) ;
+    channel_config_set_dreq(&tx.cfg, i2c_get_dreq(i2c, true)) ;
+}
+
+static bool HOT_FUNC(i2c_read_timeout)(i2c_inst_t *i2c, uint8_t *b) {
+    uint32_t t = time_us_32() ;
+    while (!i2c_get_read_available(i2c)) {
+        if (time_us_32() - t > I2C_BYTE_TIMEOUT_US) {
+            return false ;
+        }
+        tight_loop_contents() ;
+    }
+
+    *b = i2c_read_byte_raw(i2c) ;
+    return true ;
+}
+
+static void HOT_FUNC(i2c_receive_frame)(i2c_inst_t *i2c) {
+    if (context.pending) {
+        bus_errors.restarts++ ;
+    }
+
+    stretch.active = false ;
+    context.valid = false ;
+    context.pending = false ;
+    context.nak = false ;
+    context.replay = false ;
+    context.busy = false ;
+
+    uint8_t f[5] ;
+    if (!i2c_read_timeout(i2c, &f[0])) {
+        bus_errors.timeouts++ ;
+        return ;
+    }
+
+    context.addr = f[0] & ~BUS_FRAMED ;
+    context.framed = f[0] & BUS_FRAMED ;
+
+    uint8_t len = 1 + (context.addr & CSR_WRITE ? 2 : 0) + (context.framed ? 2 : 0) ;
+    for (uint8_t n = 1; n < len; n++) {
+        if (!i2c_read_timeout(i2c, &f[n])) {
+            bus_errors.timeouts++ ; // master gave up mid-frame, never execute a partial write
+            while (i2c_get_read_available(i2c)) {
+                (void) i2c_read_byte_raw(i2c) ;
+            }
+            return ;
+        }
+    }
+
+    context.valid = true ;
+
+    if (context.framed) {
+        context.seq = f[len - 2] ;
+        if (crc8(f, len - 1) != f[len - 1]) {
+            bus_errors.crc++ ;
+            context.nak = true ;
+            return ;
+        }
+
+        if (last.valid && last.seq == context.seq && last.addr == f[0]) {
+            bus_errors.replays++ ;
+            context.replay = true ;
+            return ;
+        }
+
+        last.valid = false ;
+    }
+
+    const CSR *c = csr_lookup(context.addr) ;
+    if (c && c->strobe && !(context.addr & CSR_WRITE)) {
+        c->strobe(c->dev) ;
+        bus_wake_device() ;
+        trace_record(context.addr, TRACE_RESET, 0, 0) ;
+    } else if (context.addr & CSR_WRITE) {
+        context.value = f[1] | (f[2] << 8) ;
+        context.pending = true ;
+    }
+}
+
+// may_wait leaves the TX FIFO empty for a register that is not ready, the slave
+// then stretches SCL until bus_poll answers
+static void HOT_FUNC(i2c_respond)(i2c_inst_t *i2c, bool may_wait) {
+    if (context.replay) {
+        i2c_send(i2c) ;
+        return ;
+    }
+
+    uint16_t v = 0 ;
+    bool data = false ;
+    uint8_t ack = BUS_ACK_ERR ;
+
+    tx.len = 0 ;
+    tx.crc = 0 ;
+
+    const CSR *c = csr_lookup(context.addr) ;
+    if (context.nak) {
+        ack = BUS_ACK_NAK ;
+    } else if (c == NULL) {
+        ack = BUS_ACK_ERR ;
+    } else if (c->burst && (context.addr & CSR_WRITE)) {
+        context.pending = false ; // read-only, answered with BUS_ACK_ERR
+    } else if (context.addr & CSR_WRITE) {
+        if (context.pending && c->write) {
+            c->write(c->dev, context.value & c->wmask) ;
+            bus_wake_device() ;
+        }
+        context.pending = false ;
+        v = c->status(c->dev) ;
+        ack = BUS_ACK_OK ;
+        trace_record(context.addr, TRACE_WRITE, context.value, v) ;
+    } else if (c->strobe) {
+        ack = BUS_ACK_OK ;
+    } else if (c->burst && tx.dma < 0 && 2 * CSR_BURST_MAX + 3 > BUS_TX_FIFO_DEPTH) {
+        // without DMA the FIFO cannot take a whole burst, refuse it rather than cut it short
+    } else if (c->burst) {
+        uint16_t words[CSR_BURST_MAX] ;
+        uint8_t n = c->burst(words) ;
+        for (uint8_t i = 0; i < n; i++) {
+            tx_put(words[i] & 0377) ;
+            tx_put((words[i] >> 8) & 0377) ;
+        }
+        ack = BUS_ACK_OK ;
+        trace_record(context.addr, TRACE_READ, n, 0) ;
+    } else if (context.busy) {
+        data = true ; // keep the usual length, the host must look at the ack
+        ack = BUS_ACK_BUSY ;
+        trace_record(context.addr, TRACE_READ, 0, c->status(c->dev)) ;
+    } else {
+        if (may_wait && c->ready && !c->ready(c->dev)) {
+            stretch.since = time_us_32() ;
+            stretch.active = true ;
+            stretch.count++ ;
+            return ;
+        }
+
+        v = c->read(c->dev) ;
+        data = true ;
+        ack = BUS_ACK_OK ;
+        trace_record(context.addr, TRACE_READ, v, c->status(c->dev)) ;
+    }
+
+    // framed responses always carry a word, plain ones only for reads
+    if (tx.len == 0 && (data || context.framed)) {
+        tx_put(v & 0377) ;
+        tx_put((v >> 8) & 0377) ;
+    }
+    tx_put(ack) ;
+
+    if (context.framed) {
+        tx_put(context.seq) ;
+        tx_put(tx.crc) ;
+    }
+
+    i2c_send(i2c) ;
+
+    // tx keeps the response for a retry, a NAK'd frame is resent with the same
+    // seq and must then be executed
+    last.valid = context.framed && !context.nak && !context.busy ; // a retry must read again
+    last.addr = context.addr | BUS_FRAMED ;
+    last.seq = context.seq ;
+    context.replay = last.valid ; // a second read in the same transfer must not re-execute
+}
+
+static void HOT_FUNC(i2c_slave_handler)(i2c_inst_t *i2c, i2c_slave_event_t event) {
+    uint32_t t = time_us_32() ;
+    bus_events++ ;
+    bus_last_us = t ;
+    power_activity() ;
+
+    switch (event) {
+        case I2C_SLAVE_RECEIVE:
+            gpio_put(PICO_DEFAULT_LED_PIN, false) ;
+            i2c_receive_frame(i2c) ;
+            gpio_put(PICO_DEFAULT_LED_PIN, true) ;
+            break;
+        case I2C_SLAVE_REQUEST:
+            gpio_put(PICO_DEFAULT_LED_PIN, false) ;
+
+            // always answer, an empty TX FIFO would stretch SCL until recovery
+            if (!context.valid) {
+                bus_errors.stale++ ;
+                i2c_write_byte_raw(i2c, BUS_ACK_ERR) ;
+            } else {
+                i2c_respond(i2c, BUS_STRETCH_TIMEOUT_US > 0) ;
+            }
+
+            gpio_put(PICO_DEFAULT_LED_PIN, true) ;
+            break;
+        case I2C_SLAVE_FINISH:
+            if (tx.dma >= 0 && dma_channel_is_busy(tx.dma)) {
+                dma_channel_abort(tx.dma) ; // master stopped reading early
+            }
+            gpio_put(PICO_DEFAULT_LED_PIN, false) ;
+            break;
+        default:
+            break;
+    }
+
+    t = time_us_32() - t ;
+    if (t > handler_max_us) {
+        handler_max_us = t ;
+    }
+}
+
+static void i2c_slave_setup() {
+    context.valid = false ;
+    context.pending = false ;
+    last.valid = false ;
+    stretch.active = false ;
+
+    baud_hz = i2c_init(i2c0, I2C_BAUDRATE) ;
+    i2c_slave_init(i2c0, I2C_SLAVE_ADDRESS, &i2c_slave_handler) ;
+
+    if (tx.dma >= 0) {
+        i2c_get_hw(i2c0)->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS ;
+        i2c_get_hw(i2c0)->dma_tdlr = 4 ;
+    }
+}
+
+// finish a stretched read once the device side has served it
+static void HOT_FUNC(bus_poll)() {
+    if (!stretch.active) {
+        return ;
+    }
+
+    const CSR *c = csr_lookup(context.addr) ;
+    bool ready = c->ready(c->dev) ;
+    if (!ready && time_us_32() - stretch.since < BUS_STRETCH_TIMEOUT_US) {
+        return ;
+    }
+
+    uint32_t save = save_and_disable_interrupts() ;
+    if (stretch.active) {
+        stretch.active = false ;
+        if (!ready) {
+            stretch.timeouts++ ;
+            context.busy = true ; // reading now would return the BUSY placeholder as data
+        }
+        i2c_respond(i2c0, false) ;
+    }
+    restore_interrupts(save) ;
+}
+
+void bus_init() {
+    i2c_tx_dma_init(i2c0) ;
+
+    gpio_init(I2C_SLAVE_SDA_PIN) ;
+    gpio_set_function(I2C_SLAVE_SDA_PIN, GPIO_FUNC_I2C) ;
+    gpio_pull_up(I2C_SLAVE_SDA_PIN) ;
+
+    gpio_init(I2C_SLAVE_SCL_PIN) ;
+    gpio_set_function(I2C_SLAVE_SCL_PIN, GPIO_FUNC_I2C) ;
+    gpio_pull_up(I2C_SLAVE_SCL_PIN) ;
+
+    i2c_slave_setup() ;
+}
+
+// A transaction that makes no progress for I2C_STUCK_TIMEOUT_US with a line held low
+// is treated as stuck. Resetting the slave block releases anything we hold, so
+// recovery is bounded by one timeout plus a re-init. A line that stays low after
+// that is held by the master or another device: a slave has no SCL to clock a
+// stuck SDA free with, that is the master's job. The episode is counted once and
+// the re-init backs off until the bus is idle again or makes progress.
+static void bus_check() {
+    static uint32_t events = 0 ;
+    static uint32_t since = 0 ;
+    static uint32_t wait_us = I2C_STUCK_TIMEOUT_US ;
+    static bool stuck = false ;
+
+    uint32_t now = time_us_32() ;
+    if (stretch.active) {
+        since = now ; // we hold SCL ourselves, bounded by bus_poll
+        return ;
+    }
+
+    bool sda = gpio_get(I2C_SLAVE_SDA_PIN) ;
+    bool scl = gpio_get(I2C_SLAVE_SCL_PIN) ;
+    if ((sda && scl) || bus_events != events) {
+        events = bus_events ;
+        since = now ;
+        wait_us = I2C_STUCK_TIMEOUT_US ;
+        stuck = false ;
+        return ;
+    }
+
+    if (now - since < wait_us) {
+        return ;
+    }
+
+    if (!stuck) {
+        stuck = true ;
+        if (!scl) {
+            bus_errors.stuck_scl++ ;
+        } else {
+            bus_errors.stuck_sda++ ;
+        }
+    } else if (wait_us < I2C_STUCK_BACKOFF_MAX_US) {
+        wait_us *= 2 ;
+    }
+
+    i2c_slave_deinit(i2c0) ;
+    i2c_deinit(i2c0) ;
+    i2c_slave_setup() ;
+    bus_errors.recoveries++ ;
+
+    since = time_us_32() ;
+}
+
+void bus_task() {
+    bus_poll() ;
+    bus_check() ;
+}
+
+// nothing to poll for until the next IRQ or doorbell
+bool bus_idle() {
+    return !stretch.active ;
+}
+
+uint bus_baud_hz() {
+    return baud_hz ;
+}
+
+// time since the last I2C event, for background work that must yield to the host
+uint32_t bus_quiet_us() {
+    return time_us_32() - bus_last_us ;
+}
+
+void bus_show_errors() {
+    printf("i2c timeouts %u restarts %u stale %u crc %u replays %u stuck scl %u sda %u recoveries %u\n",
+        bus_errors.timeouts, bus_errors.restarts, bus_errors.stale, bus_errors.crc, bus_errors.replays,
+        bus_errors.stuck_scl, bus_errors.stuck_sda, bus_errors.recoveries) ;
+    printf("i2c stretched %u timeouts %u\n", stretch.count, stretch.timeouts) ;
+    printf("i2c core %u handler max %u us\n", BUS_CORE, handler_max_us) ;
+}
@@ -0,0 +1,51 @@
+#ifndef _BUS_H_
+#define _BUS_H_
+
+#include "pico/types.h"
+
+// I2C slave front end of the CSR table.
+//
+// Plain frame:  addr [lo hi]           -> [lo hi] ack
+// Framed:       addr|0200 [lo hi] seq crc -> lo hi ack seq crc
+//
+// lo/hi are sent for reads, and for framed writes they carry the status after
+// the write. ack is BUS_ACK_OK, BUS_ACK_ERR for an unknown register or
+// BUS_ACK_NAK for a framed request with a bad CRC, which the host must resend.
+// crc is CRC-8 (poly 0x07, init 0, as SMBus PEC) over all preceding bytes of the
+// frame. Resending a frame with the same seq replays the previous response
+// without touching the registers again, so a read of PRB can be retried safely.
+//
+// With BUS_STRETCH_TIMEOUT_US set, a read of PRB while the reader is BUSY holds
+// SCL low until the byte arrives and then returns it. The host needs one
+// transaction per byte instead of polling PRS for DONE. If the timeout expires
+// first, nothing is read: lo/hi are 0 and ack is BUS_ACK_BUSY, and the response
+// is not kept for a replay, so the host can retry with the same seq.
+
+#define BUS_FRAMED 0200
+
+#define BUS_ACK_ERR 0
+#define BUS_ACK_OK  1
+#define BUS_ACK_NAK 2
+#define BUS_ACK_BUSY 3 // stretched read timed out, nothing was read
+
+// Core that takes the I2C IRQ and runs bus_task. Core 1 never touches the SD
+// card, so bus latency does not depend on storage latency.
+#ifndef BUS_CORE
+#define BUS_CORE 1
+#endif
+
+#ifndef BUS_STRETCH_TIMEOUT_US
+#define BUS_STRETCH_TIMEOUT_US 0 // hold SCL on a PRB read while BUSY, 0 disables
+#endif
+
+// both on BUS_CORE
+void bus_init() ;
+void bus_task() ;
+bool bus_idle() ;
+
+uint32_t bus_quiet_us() ;
+uint bus_baud_hz() ;
+
+void bus_show_errors() ;
+
+#endif
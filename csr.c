@@ -0,0 +1,111 @@
+#include "csr.h"
+
+#include "hot.h"
+
+READER_REGS ptr_regs[PC11_UNITS] ;
+PUNCH_REGS ptp_regs[PC11_UNITS] ;
+PUNCH_REGS lp_regs[LP11_UNITS] ;
+volatile bool pc11_rst = false ;
+
+// reader
+
+static uint16_t HOT_FUNC(prs_read)(void *dev) {
+    return pc11_rst ? CSR_BUSY : reader_csr(dev) ;
+}
+
+static void HOT_FUNC(prs_write)(void *dev, uint16_t v) {
+    reader_csr_write(dev, v) ;
+}
+
+static uint16_t HOT_FUNC(prb_read)(void *dev) {
+    return reader_buf_read(dev) ; // clears DONE
+}
+
+static uint16_t HOT_FUNC(reader_status)(const void *dev) {
+    return reader_csr(dev) ;
+}
+
+static bool HOT_FUNC(prb_ready)(const void *dev) {
+    return !(reader_csr(dev) & CSR_BUSY) ;
+}
+
+// punch, printer
+
+static uint16_t HOT_FUNC(pps_read)(void *dev) {
+    return pc11_rst ? 0 : punch_csr(dev) ;
+}
+
+static uint16_t HOT_FUNC(xxs_read)(void *dev) {
+    return punch_csr(dev) ;
+}
+
+static void HOT_FUNC(xxs_write)(void *dev, uint16_t v) {
+    punch_csr_write(dev, v) ;
+}
+
+static uint16_t HOT_FUNC(xxb_read)(void *dev) {
+    return punch_buf(dev) ;
+}
+
+static void HOT_FUNC(xxb_write)(void *dev, uint16_t v) {
+    punch_buf_write(dev, v) ;
+}
+
+static uint16_t HOT_FUNC(punch_status)(const void *dev) {
+    return punch_csr(dev) ;
+}
+
+// reset
+
+static void HOT_FUNC(rst_strobe)(void *dev) {
+    pc11_rst = true ;
+}
+
+static uint16_t HOT_FUNC(rst_status)(const void *dev) {
+    return 0 ;
+}
+
+// diagnostics
+
+static uint8_t HOT_FUNC(snapshot_burst)(uint16_t *out) {
+    for (uint8_t i = 0; i < CSR_COUNT; i++) {
+        const CSR *c = &csr_table[i] ;
+        out[i] = c->status && c->dev ? c->status(c->dev) : 0 ;
+    }
+    return CSR_COUNT ;
+}
+
+#define LP11_CSRS(base, u) \
+    [((base) + LP11_LPS) >> 1] = { xxs_read, xxs_write, punch_status,  NULL, &lp_regs[u],  077577 },  /* bits 15,7 are read-only */ \
+    [((base) + LP11_LPB) >> 1] = { xxb_read, xxb_write, punch_status,  NULL, &lp_regs[u],  0177777 }
+
+#define PC11_CSRS(base, u) \
+    [((base) + PC11_PRS) >> 1] = { prs_read, prs_write, reader_status, NULL, &ptr_regs[u], 0101 },    /* only bits 6,0 are write-able */ \
+    [((base) + PC11_PRB) >> 1] = { prb_read, NULL,      reader_status, NULL, &ptr_regs[u], 0, prb_ready }, /* read-only */ \
+    [((base) + PC11_PPS) >> 1] = { pps_read, xxs_write, punch_status,  NULL, &ptp_regs[u], 077577 }, \
+    [((base) + PC11_PPB) >> 1] = { xxb_read, xxb_write, punch_status,  NULL, &ptp_regs[u], 0177777 }
+
+const CSR HOT_DATA csr_table[CSR_COUNT] = {
+    LP11_CSRS(LP11_BASE0, 0),
+#if LP11_UNITS > 1
+    LP11_CSRS(LP11_BASE1, 1),
+#endif
+#if LP11_UNITS > 2
+    LP11_CSRS(LP11_BASE2, 2),
+#endif
+#if LP11_UNITS > 3
+    LP11_CSRS(LP11_BASE3, 3),
+#endif
+    PC11_CSRS(PC11_BASE0, 0),
+#if PC11_UNITS > 1
+    PC11_CSRS(PC11_BASE1, 1),
+#endif
+#if PC11_UNITS > 2
+    PC11_CSRS(PC11_BASE2, 2),
+#endif
+#if PC11_UNITS > 3
+    PC11_CSRS(PC11_BASE3, 3),
+#endif
+    [PC11_RST >> 1] = { NULL, NULL, rst_status, rst_strobe, NULL, 0 },
+    [CSR_SNAPSHOT >> 1] = { .burst = snapshot_burst },
+} ;
@@ -0,0 +1,97 @@
+#ifndef _CSR_H_
+#define _CSR_H_
+
+#include "pico/types.h"
+#include "regfile.h"
+
+// Instances share one slave address and are told apart by register offset.
+// PC11 unit n is a reader/punch pair, bases follow the Unibus low address bits.
+
+#ifndef PC11_UNITS
+#define PC11_UNITS 2
+#endif
+
+#ifndef LP11_UNITS
+#define LP11_UNITS 2
+#endif
+
+#ifndef LP11_BASE0
+#define LP11_BASE0 014 // 177514
+#endif
+
+#ifndef LP11_BASE1
+#define LP11_BASE1 004 // 164004
+#endif
+
+#ifndef PC11_BASE0
+#define PC11_BASE0 050 // 177550
+#endif
+
+#ifndef PC11_BASE1
+#define PC11_BASE1 070
+#endif
+
+// Units 2 and 3 have no default base, a build with more units places them in
+// free even offsets; overlapping bases only show up as -Woverride-init warnings.
+#if PC11_UNITS > 4 || LP11_UNITS > 4
+#error csr_table maps at most 4 PC11 and 4 LP11 units
+#endif
+
+#if (PC11_UNITS > 2 && !defined(PC11_BASE2)) || (PC11_UNITS > 3 && !defined(PC11_BASE3))
+#error PC11_UNITS above 2 needs PC11_BASE2 (and PC11_BASE3 for 4)
+#endif
+
+#if (LP11_UNITS > 2 && !defined(LP11_BASE2)) || (LP11_UNITS > 3 && !defined(LP11_BASE3))
+#error LP11_UNITS above 2 needs LP11_BASE2 (and LP11_BASE3 for 4)
+#endif
+
+// offsets within a unit
+#define LP11_LPS 0
+#define LP11_LPB 2
+#define PC11_PRS 0
+#define PC11_PRB 2
+#define PC11_PPS 4
+#define PC11_PPB 6
+
+#define PC11_RST 060 // resets all PC11 and LP11 units
+#define CSR_SNAPSHOT 062 // burst: status of every register offset
+
+#define CSR_WRITE 0100 // I2C address flag: frame carries a 16-bit value
+#define CSR_COUNT 32   // even offsets 000..076
+#define CSR_BURST_MAX CSR_COUNT
+
+// One entry per register offset. read/write are the bus side effects, status is
+// the side-effect free status of the owning device, wmask drops read-only bits
+// before write. A strobe register acts when its address arrives and has no value.
+// ready, if set, tells whether a read can be answered with fresh data right away.
+// A burst register answers a read with up to CSR_BURST_MAX words instead of one;
+// it is read-only and needs no status, csr_lookup maps it by burst alone.
+typedef struct {
+    uint16_t (*read)(void *dev) ;
+    void (*write)(void *dev, uint16_t v) ;
+    uint16_t (*status)(const void *dev) ;
+    void (*strobe)(void *dev) ;
+    void *dev ;
+    uint16_t wmask ;
+    bool (*ready)(const void *dev) ;
+    uint8_t (*burst)(uint16_t *out) ;
+} CSR ;
+
+extern const CSR csr_table[CSR_COUNT] ;
+
+extern READER_REGS ptr_regs[PC11_UNITS] ;
+extern PUNCH_REGS ptp_regs[PC11_UNITS] ;
+extern PUNCH_REGS lp_regs[LP11_UNITS] ;
+extern volatile bool pc11_rst ;
+
+// NULL for an unmapped address
+static inline const CSR *csr_lookup(uint8_t a) {
+    if (a & 0201) {
+        return NULL ;
+    }
+
+    const CSR *c = &csr_table[(a & ~CSR_WRITE) >> 1] ;
+    return c->status || c->burst ? c : NULL ;
+}
+
+#endif
@@ -0,0 +1,65 @@
+#include "doorbell.h"
+
+#include "pico/time.h"
+#include "hardware/sync.h"
+#include "bus.h"
+#include "hot.h"
+#include "power.h"
+
+static spin_lock_t *lock ;
+static volatile uint32_t pending[2] ;
+static repeating_timer_t tick_timer ;
+static volatile bool ticking = false ;
+
+// output idle flush, stuck bus check and queue retries on the bus core. None
+// of them has work once idle (outputs flushed, queues empty), so the tick
+// stops there and doorbell_tick_resume starts it again
+static bool tick(repeating_timer_t *t) {
+    if (power_is_idle()) {
+        ticking = false ;
+        return false ;
+    }
+
+    doorbell_ring(BUS_CORE, DOORBELL_TICK) ;
+    return true ;
+}
+
+// core 0, like the timer's IRQ, so tick never runs in the middle of this
+void doorbell_tick_resume() {
+    if (!ticking) {
+        ticking = add_repeating_timer_ms(-DOORBELL_TICK_MS, tick, NULL, &tick_timer) ;
+    }
+}
+
+// before core 1 is launched
+void doorbell_init() {
+    lock = spin_lock_init(spin_lock_claim_unused(true)) ;
+    doorbell_tick_resume() ;
+}
+
+void HOT_FUNC(doorbell_ring)(uint core, uint32_t bits) {
+    uint32_t save = spin_lock_blocking(lock) ;
+    pending[core] |= bits ;
+    spin_unlock(lock, save) ;
+    __sev() ;
+}
+
+uint32_t doorbell_take() {
+    uint core = get_core_num() ;
+    uint32_t save = spin_lock_blocking(lock) ;
+    uint32_t bits = pending[core] ;
+    pending[core] = 0 ;
+    spin_unlock(lock, save) ;
+    return bits ;
+}
+
+uint32_t doorbell_wait() {
+    uint32_t bits = doorbell_take() ;
+    if (bits == 0) {
+        power_sleep_mode() ;
+        __wfe() ; // a ring or an IRQ after the take still ends the wait
+        bits = doorbell_take() ;
+    }
+
+    return bits ;
+}
@@ -0,0 +1,36 @@
+#ifndef _DOORBELL_H_
+#define _DOORBELL_H_
+
+#include "pico/types.h"
+
+// Inter-core doorbells. Each core owns a word of pending event bits that the
+// other core or an IRQ sets under a hardware spinlock and announces with __sev().
+// The spinlock orders the data written before the ring against the owner's
+// read after doorbell_take. The owner sleeps in __wfe() while nothing is
+// pending.
+
+#define DOORBELL_TICK     01 // DOORBELL_TICK_MS elapsed, bus core only, stopped while idle
+#define DOORBELL_STORAGE  02 // storage request queued or completion slot freed
+#define DOORBELL_DEVICE   04 // storage completion queued, tape loaded
+#define DOORBELL_PROGRESS 010 // reader position changed
+#define DOORBELL_ERROR    020 // pclp11_error set
+#define DOORBELL_KEY      040 // key edge
+#define DOORBELL_CONSOLE  0100 // stdio input available
+#define DOORBELL_REFRESH  0200 // display refresh timer
+#define DOORBELL_RENDER   0400 // render command queued or LCD transfer done
+#define DOORBELL_POWER    01000 // idle check due or activity while idle
+
+#define DOORBELL_TICK_MS 10
+
+#define STORAGE_CORE 0 // runs storage_task and the UI
+
+void doorbell_init() ;
+void doorbell_tick_resume() ; // core 0, after the idle power state, see power.h
+void doorbell_ring(uint core, uint32_t bits) ;
+uint32_t doorbell_take() ;
+
+// take the bits of the calling core, sleeping first if there are none; may
+// return 0 after an interrupt woke the core, callers just poll again
+uint32_t doorbell_wait() ;
+
+#endif
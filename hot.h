@@ -0,0 +1,22 @@
+#ifndef _HOT_H_
+#define _HOT_H_
+
+#include "pico.h"
+
+// Code and tables on the I2C interrupt path are linked into SRAM (the SDK
+// copies .time_critical.* there at boot), so an XIP cache miss cannot delay a
+// response. Build with HOT_IN_SRAM=0 to leave them in flash and compare the
+// latency histograms and XIP cache counters that latency_show prints.
+#ifndef HOT_IN_SRAM
+#define HOT_IN_SRAM 1
+#endif
+
+#if HOT_IN_SRAM
+#define HOT_FUNC(f) __not_in_flash_func(f)
+#define HOT_DATA __not_in_flash("hot")
+#else
+#define HOT_FUNC(f) f
+#define HOT_DATA
+#endif
+
+#endif
@@ -0,0 +1,23 @@
+#include "irqprio.h"
+
+#include "hardware/irq.h"
+
+// every interrupt the firmware enables; the latency probe alarms set their own
+const IRQ_SOURCE irq_sources[] = {
+    { I2C0_IRQ,     IRQ_PRIO_BUS,   "i2c0" },
+    { DMA_IRQ_0,    IRQ_PRIO_DMA,   "dma0" },
+    { DMA_IRQ_1,    IRQ_PRIO_DMA,   "dma1" },
+    { PIO0_IRQ_0,   IRQ_PRIO_DMA,   "pio0" },
+    { PIO1_IRQ_0,   IRQ_PRIO_DMA,   "pio1" },
+    { TIMER_IRQ_3,  IRQ_PRIO_TIMER, "timer3" },
+    { IO_IRQ_BANK0, IRQ_PRIO_IO,    "gpio" },
+    { UART0_IRQ,    IRQ_PRIO_IO,    "uart0" },
+} ;
+
+const uint8_t irq_source_count = count_of(irq_sources) ;
+
+void irqprio_init() {
+    for (uint8_t i = 0; i < irq_source_count; i++) {
+        irq_set_priority(irq_sources[i].irq, irq_sources[i].prio) ;
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef _IRQPRIO_H_
+#define _IRQPRIO_H_
+
+#include "pico/types.h"
+
+// Central NVIC priorities, lower is more urgent and the RP2040 only keeps the
+// top 2 bits. Only the I2C slave sits at IRQ_PRIO_BUS, so a new source can
+// delay a host transaction by its entry only, never by its handler.
+#define IRQ_PRIO_BUS   0x00 // I2C slave
+#define IRQ_PRIO_DMA   0x40 // transfer completion (SD, LCD)
+#define IRQ_PRIO_TIMER 0x80 // default alarm pool: doorbell tick, display refresh
+#define IRQ_PRIO_IO    0xc0 // keys, console UART
+
+typedef struct {
+    uint        irq ;
+    uint8_t     prio ;
+    const char *name ;
+} IRQ_SOURCE ;
+
+extern const IRQ_SOURCE irq_sources[] ;
+extern const uint8_t irq_source_count ;
+
+// each core has its own NVIC, call on both before enabling sources
+void irqprio_init() ;
+
+#endif
@@ -0,0 +1,142 @@
+#include "jobs.h"
+
+#include <stdio.h>
+#include "pico/time.h"
+#include "bus.h"
+#include "doorbell.h"
+#include "storage.h"
+
+typedef struct {
+    const char *name ;
+    job_step_t  step ;
+    job_end_t   end ;
+    void       *ctx ;
+    uint8_t     prio ;
+    bool        used ;
+    bool        cancel ;
+    uint32_t    steps ;
+    uint32_t    run_us ;   // time spent in step
+    uint32_t    start_us ; // submitted
+} JOB ;
+
+static JOB jobs[JOB_SLOTS] ;
+static uint8_t next = 0 ;
+static volatile alarm_id_t quiet_check = 0 ;
+
+int job_submit(const char *name, uint8_t prio, job_step_t step, job_end_t end, void *ctx) {
+    for (int id = 0; id < JOB_SLOTS; id++) {
+        JOB *j = &jobs[id] ;
+        if (!j->used) {
+            j->name = name ;
+            j->step = step ;
+            j->end = end ;
+            j->ctx = ctx ;
+            j->prio = prio < JOB_CLASSES ? prio : JOB_LOW ;
+            j->cancel = false ;
+            j->steps = 0 ;
+            j->run_us = 0 ;
+            j->start_us = time_us_32() ;
+            j->used = true ;
+            return id ;
+        }
+    }
+
+    return -1 ;
+}
+
+// takes effect before the next step
+void job_cancel(int id) {
+    if (id >= 0 && id < JOB_SLOTS && jobs[id].used) {
+        jobs[id].cancel = true ;
+    }
+}
+
+void job_cancel_all() {
+    for (int id = 0; id < JOB_SLOTS; id++) {
+        job_cancel(id) ;
+    }
+}
+
+bool job_pending() {
+    for (int id = 0; id < JOB_SLOTS; id++) {
+        if (jobs[id].used) {
+            return true ;
+        }
+    }
+
+    return false ;
+}
+
+static void job_end(JOB *j, bool cancelled) {
+    printf("job %s %s after %u us in %u steps, %u ms wall\n", j->name, cancelled ? "cancelled" : "done",
+        j->run_us, j->steps, (time_us_32() - j->start_us) / 1000) ;
+    if (j->end) {
+        j->end(j->ctx, cancelled) ;
+    }
+    j->used = false ;
+}
+
+static int64_t quiet_alarm(alarm_id_t id, void *user_data) {
+    quiet_check = 0 ;
+    doorbell_ring(STORAGE_CORE, DOORBELL_STORAGE) ;
+    return 0 ;
+}
+
+// wake the UI core when the quiet window can have passed, so it sleeps
+// meanwhile instead of polling; -1 (no alarm slot) is retried next time
+static void job_defer(uint32_t us) {
+    if (quiet_check <= 0 && job_pending()) {
+        quiet_check = add_alarm_in_us(us, quiet_alarm, NULL, true) ;
+    }
+}
+
+bool job_run() {
+    if (!storage_idle()) {
+        job_defer(JOB_QUIET_US) ;
+        return false ;
+    }
+    uint32_t quiet = bus_quiet_us() ;
+    if (quiet < JOB_QUIET_US) {
+        job_defer(JOB_QUIET_US - quiet) ;
+        return false ;
+    }
+
+    JOB *pick = NULL ;
+    for (uint8_t n = 0; n < JOB_SLOTS; n++) {
+        JOB *j = &jobs[(next + n) % JOB_SLOTS] ;
+        if (j->used && (pick == NULL || j->prio < pick->prio)) {
+            pick = j ;
+        }
+    }
+
+    if (pick == NULL) {
+        return false ;
+    }
+    next = (pick - jobs + 1) % JOB_SLOTS ;
+
+    if (pick->cancel) {
+        job_end(pick, true) ;
+        return true ;
+    }
+
+    uint32_t t = time_us_32() ;
+    bool more = pick->step(pick->ctx) ;
+    pick->run_us += time_us_32() - t ;
+    pick->steps++ ;
+
+    if (!more) {
+        job_end(pick, false) ;
+    }
+
+    return true ;
+}
+
+void job_show() {
+    for (int id = 0; id < JOB_SLOTS; id++) {
+        JOB *j = &jobs[id] ;
+        if (j->used) {
+            printf("job %d %s prio %u %u us in %u steps%s\n", id, j->name, j->prio, j->run_us, j->steps,
+                j->cancel ? " cancelling" : "") ;
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef _JOBS_H_
+#define _JOBS_H_
+
+#include "pico/types.h"
+
+// Cooperative background jobs on the UI core. A job is a step function that
+// does one bounded slice of work per call and returns false when finished.
+// job_run only steps a job while storage requests and the I2C bus have been
+// quiet for JOB_QUIET_US, so device traffic always goes first; the most urgent
+// class runs first, round robin within a class. A deferred job arms an alarm
+// that rings DOORBELL_STORAGE once the window can have passed.
+
+#define JOB_SLOTS    4
+#define JOB_QUIET_US 5000
+
+enum {
+    JOB_HIGH,
+    JOB_NORMAL,
+    JOB_LOW,
+    JOB_CLASSES
+} ;
+
+typedef bool (*job_step_t)(void *ctx) ;
+typedef void (*job_end_t)(void *ctx, bool cancelled) ; // optional
+
+int job_submit(const char *name, uint8_t prio, job_step_t step, job_end_t end, void *ctx) ; // id, -1 when full
+void job_cancel(int id) ;
+void job_cancel_all() ;
+bool job_pending() ;
+bool job_run() ; // false when no job could run, poll again only after a doorbell
+void job_show() ;
+
+#endif
@@ -0,0 +1,179 @@
+#include "latency.h"
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/irq.h"
+#include "hardware/structs/xip_ctrl.h"
+#include "hot.h"
+#include "irqprio.h"
+#include "power.h"
+
+// power of two buckets: <1, <2, <4 ... <128 us, then the rest
+#define LATENCY_BUCKETS 9
+
+// probe period in the idle power state, still sampling the wake latency
+#ifndef LATENCY_IDLE_PERIOD_US
+#define LATENCY_IDLE_PERIOD_US 100000
+#endif
+
+typedef struct {
+    alarm_pool_t *pool ;
+    uint8_t prio ;
+    uint64_t target ;
+    volatile uint32_t max ;
+    volatile uint32_t sum ;
+    volatile uint32_t samples ;
+    volatile uint32_t idle_max ; // wake from the idle power state
+    volatile uint32_t hist[LATENCY_BUCKETS] ;
+} PROBE ;
+
+// the probes stay below IRQ_PRIO_BUS so their handlers never delay the I2C
+// slave; the first level below it also sees the time the bus handler takes
+#if LATENCY_PER_LEVEL
+// one probe per level, each on its own hardware alarm
+static PROBE probes[] = {
+    { .prio = IRQ_PRIO_DMA },
+    { .prio = IRQ_PRIO_TIMER },
+    { .prio = IRQ_PRIO_IO },
+} ;
+#else
+static PROBE probes[] = {
+    { .prio = IRQ_PRIO_DMA },
+} ;
+#endif
+
+static uint32_t period ;
+static uint core ;
+static bool started = false ;
+
+// register write to device step, both on the bus core
+static struct {
+    volatile uint32_t mark ; // 0 while nothing is waiting
+    uint32_t max ;
+    uint32_t sum ;
+    uint32_t samples ;
+    uint32_t hist[LATENCY_BUCKETS] ;
+} step ;
+
+// a shift loop, the M0+ has no CLZ and the libgcc helper runs from flash
+static inline uint8_t bucket(uint32_t us) {
+    uint8_t b = 0 ;
+    while (us && b < LATENCY_BUCKETS - 1) {
+        us >>= 1 ;
+        b++ ;
+    }
+    return b ;
+}
+
+// prints and clears
+static void hist_show(volatile uint32_t *hist) {
+    uint8_t last = LATENCY_BUCKETS - 1 ;
+    printf("  ") ;
+    for (uint8_t b = 0; b < last; b++) {
+        printf("<%u:%u ", 1u << b, hist[b]) ;
+        hist[b] = 0 ;
+    }
+    printf(">=%u:%u\n", 1u << (last - 1), hist[last]) ;
+    hist[last] = 0 ;
+}
+
+static int64_t HOT_FUNC(latency_alarm)(alarm_id_t id, void *user_data) {
+    PROBE *p = user_data ;
+    uint32_t us = time_us_32() - (uint32_t)p->target ; // inline timer read, time_us_64 is in flash
+    if (us > p->max) {
+        p->max = us ;
+    }
+    p->sum += us ;
+    p->samples++ ;
+    p->hist[bucket(us)]++ ;
+    if (power_is_idle() && us > p->idle_max) {
+        p->idle_max = us ;
+    }
+
+    uint32_t next = power_is_idle() ? LATENCY_IDLE_PERIOD_US : period ;
+    p->target += next ;
+    return -(int64_t)next ; // negative: relative to the previous target, so lateness does not accumulate
+}
+
+void latency_probe_start(uint32_t period_us) {
+    period = period_us ;
+    core = get_core_num() ;
+
+    for (uint8_t i = 0; i < count_of(probes); i++) {
+        PROBE *p = &probes[i] ;
+        uint alarm = LATENCY_ALARM_NUM - i ;
+        p->pool = alarm_pool_create(alarm, 2) ; // IRQ on this core
+        irq_set_priority(TIMER_IRQ_0 + alarm, p->prio) ;
+        p->target = time_us_64() + period + i * period / count_of(probes) ; // spread out
+        alarm_pool_add_alarm_at(p->pool, from_us_since_boot(p->target), latency_alarm, p, true) ;
+    }
+
+    started = true ;
+}
+
+// oldest unserved event counts
+void HOT_FUNC(latency_event_mark)() {
+    if (step.mark == 0) {
+        step.mark = time_us_32() | 1 ;
+    }
+}
+
+void latency_event_done() {
+    uint32_t mark = step.mark ;
+    if (mark == 0) {
+        return ;
+    }
+
+    step.mark = 0 ;
+    uint32_t us = time_us_32() - mark ;
+    if (us > step.max) {
+        step.max = us ;
+    }
+    step.sum += us ;
+    step.samples++ ;
+    step.hist[bucket(us)]++ ;
+}
+
+// prints and restarts the measurement window
+void latency_show() {
+    if (!started) {
+        return ;
+    }
+
+    for (uint8_t i = 0; i < count_of(probes); i++) {
+        PROBE *p = &probes[i] ;
+        uint32_t max = p->max ;
+        uint32_t sum = p->sum ;
+        uint32_t samples = p->samples ;
+        uint32_t idle_max = p->idle_max ;
+        p->idle_max = 0 ;
+        p->max = 0 ;
+        p->sum = 0 ;
+        p->samples = 0 ;
+
+        printf("irq latency core %u prio 0x%02x max %u us avg %u us idle max %u us (%u samples):",
+            core, p->prio, max, samples ? sum / samples : 0, idle_max, samples) ;
+        for (uint8_t s = 0; s < irq_source_count; s++) {
+            if (irq_sources[s].prio == p->prio) {
+                printf(" %s", irq_sources[s].name) ;
+            }
+        }
+        printf("\n") ;
+        hist_show(p->hist) ;
+    }
+
+    printf("step latency max %u us avg %u us (%u events)\n",
+        step.max, step.samples ? step.sum / step.samples : 0, step.samples) ;
+    step.max = 0 ;
+    step.sum = 0 ;
+    step.samples = 0 ;
+    hist_show(step.hist) ;
+
+    // shared by both cores and counted whatever runs, writing clears them
+    uint32_t hit = xip_ctrl_hw->ctr_hit ;
+    uint32_t acc = xip_ctrl_hw->ctr_acc ;
+    xip_ctrl_hw->ctr_hit = 0 ;
+    xip_ctrl_hw->ctr_acc = 0 ;
+    printf("xip cache %u hits %u misses (%u accesses), hot paths in %s\n",
+        hit, acc - hit, acc, HOT_IN_SRAM ? "sram" : "flash") ;
+}
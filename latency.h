@@ -0,0 +1,27 @@
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+#include "pico/types.h"
+
+#ifndef LATENCY_ALARM_NUM
+#define LATENCY_ALARM_NUM 2 // 3 is the default alarm pool, further probes count down
+#endif
+
+// 1 adds probes at IRQ_PRIO_DMA and IRQ_PRIO_IO next to IRQ_PRIO_BUS
+#ifndef LATENCY_PER_LEVEL
+#define LATENCY_PER_LEVEL 0
+#endif
+
+// IRQ entry latency probe: a periodic alarm whose interrupt is taken on the core
+// that started the probe records how late it runs. Whatever delays it (masked
+// interrupts, handlers at the same or higher priority) delays every source at
+// its priority level on that core too, so latency_show lists those sources
+// with it.
+void latency_probe_start(uint32_t period_us) ;
+void latency_show() ;
+
+// Time from a register write (I2C IRQ) to the device step that serves it.
+void latency_event_mark() ;
+void latency_event_done() ;
+
+#endif
@@ -3,12 +3,25 @@
 #include "hardware/spi.h"
 #include "hardware/gpio.h"
 #include "hardware/pwm.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
 #include "pico/time.h"
 
 #define LCD_HEIGHT 240
 #define LCD_WIDTH 240
 
 static int slice_num ;
+static uint spi_hz ;
+static uint bl_pwm_hz ;
+
+static struct {
+    int chan ;
+    dma_channel_config cfg ;
+    void (*done)(void) ;
+    volatile bool active ; // CS held low for a transfer
+    uint16_t fill ;        // lcd_clear_async pattern, read through a 2 byte ring
+} dma = { -1 } ;
 
 void lcd_reset() {
     gpio_put(LCD_RST_PIN, true) ;
@@ -79,7 +92,7 @@ void lcd_clear(uint16_t color) {
 }
 
 void lcd_init() {
-    spi_init(SPI_PORT, 10000 * 1000) ;
+    spi_hz = spi_init(SPI_PORT, LCD_SPI_HZ) ;
     gpio_set_function(LCD_CLK_PIN, GPIO_FUNC_SPI) ;
     gpio_set_function(LCD_MOSI_PIN, GPIO_FUNC_SPI) ;
 
@@ -139,7 +152,9 @@ void lcd_init() {
     slice_num = pwm_gpio_to_slice_num(LCD_BL_PIN) ;
     pwm_set_wrap(slice_num, 100) ;
     pwm_set_chan_level(slice_num, PWM_CHAN_B, 1) ;
-    pwm_set_clkdiv(slice_num, 50) ;
+    float div = clock_get_hz(clk_sys) / (LCD_BL_PWM_HZ * 101.0f) ; // 50 at 125 MHz
+    pwm_set_clkdiv(slice_num, div) ;
+    bl_pwm_hz = clock_get_hz(clk_sys) / (div * 101) ;
     pwm_set_enabled(slice_num, true) ;
 
     pwm_set_chan_level(slice_num, PWM_CHAN_B, 50) ;
@@ -239,3 +254,106 @@ void lcd_display_window(uint8_t xs, uint8_t ys, uint8_t xe, uint8_t ye, uint16_t
    }
     gpio_put(LCD_CS_PIN, true);
 }
+
+uint lcd_spi_hz() {
+    return spi_hz ;
+}
+
+uint lcd_bl_pwm_hz() {
+    return bl_pwm_hz ;
+}
+
+// display off and sleep in with the backlight PWM stopped, and back
+void lcd_sleep(bool on) {
+    if (on) {
+        lcd_send_command(0x28) ; // display off
+        lcd_send_command(0x10) ; // sleep in
+        pwm_set_enabled(slice_num, false) ;
+        gpio_set_function(LCD_BL_PIN, GPIO_FUNC_SIO) ;
+        gpio_put(LCD_BL_PIN, false) ;
+    } else {
+        lcd_send_command(0x11) ; // sleep out
+        sleep_ms(5) ;
+        lcd_send_command(0x29) ; // display on
+        gpio_set_function(LCD_BL_PIN, GPIO_FUNC_PWM) ;
+        pwm_set_enabled(slice_num, true) ;
+    }
+}
+
+static void lcd_dma_irq() {
+    if (dma_channel_get_irq1_status(dma.chan)) {
+        dma_channel_acknowledge_irq1(dma.chan) ;
+        if (dma.done) {
+            dma.done() ;
+        }
+    }
+}
+
+// done is called from the DMA IRQ when a transfer has been fed to the SPI;
+// without a free channel the async calls fall back to blocking writes
+void lcd_dma_init(void (*done)(void)) {
+    dma.chan = dma_claim_unused_channel(false) ;
+    if (dma.chan < 0) {
+        return ;
+    }
+
+    dma.done = done ;
+    dma.cfg = dma_channel_get_default_config(dma.chan) ;
+    channel_config_set_transfer_data_size(&dma.cfg, DMA_SIZE_8) ;
+    channel_config_set_write_increment(&dma.cfg, false) ;
+    channel_config_set_dreq(&dma.cfg, spi_get_dreq(SPI_PORT, true)) ;
+
+    dma_channel_set_irq1_enabled(dma.chan, true) ;
+    irq_add_shared_handler(DMA_IRQ_1, lcd_dma_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY) ;
+    irq_set_enabled(DMA_IRQ_1, true) ;
+}
+
+// true while a transfer is in flight, releases CS once it is over
+bool lcd_busy() {
+    if (!dma.active) {
+        return false ;
+    }
+
+    if (dma_channel_is_busy(dma.chan)) {
+        return true ;
+    }
+
+    while (spi_is_busy(SPI_PORT)) {
+        tight_loop_contents() ; // last FIFO entries, a few us
+    }
+    gpio_put(LCD_CS_PIN, true) ;
+    dma.active = false ;
+    return false ;
+}
+
+static void lcd_dma_start(const void *src, uint32_t len, bool ring) {
+    gpio_put(LCD_DC_PIN, true) ;
+    gpio_put(LCD_CS_PIN, false) ;
+    dma.active = true ;
+
+    channel_config_set_read_increment(&dma.cfg, true) ;
+    channel_config_set_ring(&dma.cfg, false, ring ? 1 : 0) ;
+    dma_channel_configure(dma.chan, &dma.cfg, &spi_get_hw(SPI_PORT)->dr, src, len, true) ;
+}
+
+// image must stay untouched until lcd_busy returns false
+void lcd_display_window_async(uint8_t xs, uint8_t ys, uint8_t xe, uint8_t ye, uint16_t *image) {
+    if (dma.chan < 0) {
+        lcd_display_window(xs, ys, xe, ye, image) ;
+        return ;
+    }
+
+    lcd_set_window(xs, ys, xe, ye) ;
+    lcd_dma_start(image, (xe - xs) * (ye - ys) * 2, false) ;
+}
+
+void lcd_clear_async(uint16_t color) {
+    if (dma.chan < 0) {
+        lcd_clear(color) ;
+        return ;
+    }
+
+    dma.fill = ((color << 8) & 0xff00) | (color >> 8) ;
+    lcd_set_window(0, 0, LCD_WIDTH, LCD_HEIGHT) ;
+    lcd_dma_start(&dma.fill, LCD_WIDTH * LCD_HEIGHT * 2, true) ;
+}
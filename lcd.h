@@ -11,6 +11,11 @@
 #define LCD_RST_PIN  12
 #define LCD_BL_PIN   13
 
+#ifndef LCD_SPI_HZ
+#define LCD_SPI_HZ   (10 * 1000 * 1000) // limit, the divider is derived from clk_peri
+#endif
+#define LCD_BL_PWM_HZ 25000
+
 #define LCD_KEY_A     15
 #define LCD_KEY_B      7
 #define LCD_KEY_X     22
@@ -26,5 +31,14 @@ void lcd_clear(uint16_t color) ;
 // void lcd_set_window(uint8_t xs, uint8_t ys, uint8_t xe, uint8_t ye) ;
 void lcd_display_point(uint8_t x, uint8_t y, uint16_t c) ;
 void lcd_display_window(uint8_t xs, uint8_t ys, uint8_t xe, uint8_t ye, uint16_t *image) ;
+void lcd_sleep(bool on) ;
+uint lcd_spi_hz() ;
+uint lcd_bl_pwm_hz() ;
+
+// DMA variants, the caller polls lcd_busy before touching SPI_PORT or the image
+void lcd_dma_init(void (*done)(void)) ;
+bool lcd_busy() ;
+void lcd_display_window_async(uint8_t xs, uint8_t ys, uint8_t xe, uint8_t ye, uint16_t *image) ;
+void lcd_clear_async(uint16_t color) ;
 
 #endif
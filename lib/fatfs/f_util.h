@@ -24,6 +24,9 @@ extern "C" {
         UINT sz_buff,   /* Size of path name buffer (items) */
         FILINFO* fno    /* Name read buffer */
     );
+#if FF_FS_REENTRANT
+    void ff_lock_show(void);
+#endif
 
 #ifdef __cplusplus
 }
@@ -8,7 +8,7 @@ if (NOT TARGET fatfs)
             ${CMAKE_CURRENT_LIST_DIR}/ffunicode.c
     )
 
-    target_link_libraries(fatfs INTERFACE pico_stdlib hardware_clocks hardware_spi)
+    target_link_libraries(fatfs INTERFACE pico_stdlib pico_sync hardware_clocks hardware_spi)
     target_include_directories(fatfs INTERFACE ${CMAKE_CURRENT_LIST_DIR})
 
 endif ()
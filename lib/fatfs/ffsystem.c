@@ -9,6 +9,11 @@
 
 #if FF_USE_LFN == 3	/* Dynamic memory allocation */
 
+#include <stdlib.h>
+
+/* The LFN working buffer (512+ bytes) comes from the heap rather than the
+/  2 KB core stacks; pico_malloc serializes the two cores. */
+
 /*------------------------------------------------------------------------*/
 /* Allocate a memory block                                                */
 /*------------------------------------------------------------------------*/
@@ -38,6 +43,32 @@ void ff_memfree (
 
 #if FF_FS_REENTRANT	/* Mutal exclusion */
 
+#include <stdio.h>
+#include <string.h>
+#include "pico.h"
+#include "pico/time.h"
+
+/* One recursive mutex per volume, so that both cores can call FatFs. The
+/  grant also keeps lock statistics, shown by ff_lock_show(). */
+
+static recursive_mutex_t Mutex[FF_VOLUMES];
+static bool Mutex_ready[FF_VOLUMES];
+
+static struct {
+	uint32_t grants;		/* Grants given, nested ones included */
+	uint32_t contended;		/* Grants that had to wait for the other core */
+	uint32_t timeouts_seen;	/* Lock_timeouts total at the last ff_lock_show() */
+	uint32_t wait_max;		/* Longest wait [us] */
+	uint32_t holds;			/* Outermost grants released */
+	uint32_t hold_max;		/* Longest hold [us] */
+	uint32_t hold_sum;		/* Total hold [us] */
+	uint32_t since;			/* Time of the outermost grant */
+} Lock_stat[FF_VOLUMES];
+
+/* Refused grants have no holder to count them: each core counts its own */
+static volatile uint32_t Lock_timeouts[FF_VOLUMES][2];
+
+
 /*------------------------------------------------------------------------*/
 /* Create a Synchronization Object                                        */
 /*------------------------------------------------------------------------*/
@@ -46,35 +77,18 @@ void ff_memfree (
 /  When a 0 is returned, the f_mount() function fails with FR_INT_ERR.
 */
 
-//const osMutexDef_t Mutex[FF_VOLUMES];	/* Table of CMSIS-RTOS mutex */
-
-
 int ff_cre_syncobj (	/* 1:Function succeeded, 0:Could not create the sync object */
 	BYTE vol,			/* Corresponding volume (logical drive number) */
 	FF_SYNC_t* sobj		/* Pointer to return the created sync object */
 )
 {
-	/* Win32 */
-	*sobj = CreateMutex(NULL, FALSE, NULL);
-	return (int)(*sobj != INVALID_HANDLE_VALUE);
-
-	/* uITRON */
-//	T_CSEM csem = {TA_TPRI,1,1};
-//	*sobj = acre_sem(&csem);
-//	return (int)(*sobj > 0);
-
-	/* uC/OS-II */
-//	OS_ERR err;
-//	*sobj = OSMutexCreate(0, &err);
-//	return (int)(err == OS_NO_ERR);
-
-	/* FreeRTOS */
-//	*sobj = xSemaphoreCreateMutex();
-//	return (int)(*sobj != NULL);
-
-	/* CMSIS-RTOS */
-//	*sobj = osMutexCreate(&Mutex[vol]);
-//	return (int)(*sobj != NULL);
+	/* The mutex outlives remounts, the other core may still be waiting on it */
+	if (!Mutex_ready[vol]) {
+		recursive_mutex_init(&Mutex[vol]);
+		Mutex_ready[vol] = true;
+	}
+	*sobj = &Mutex[vol];
+	return 1;
 }
 
 
@@ -90,23 +104,7 @@ int ff_del_syncobj (	/* 1:Function succeeded, 0:Could not delete due to an error
 	FF_SYNC_t sobj		/* Sync object tied to the logical drive to be deleted */
 )
 {
-	/* Win32 */
-	return (int)CloseHandle(sobj);
-
-	/* uITRON */
-//	return (int)(del_sem(sobj) == E_OK);
-
-	/* uC/OS-II */
-//	OS_ERR err;
-//	OSMutexDel(sobj, OS_DEL_ALWAYS, &err);
-//	return (int)(err == OS_NO_ERR);
-
-	/* FreeRTOS */
-//  vSemaphoreDelete(sobj);
-//	return 1;
-
-	/* CMSIS-RTOS */
-//	return (int)(osMutexDelete(sobj) == osOK);
+	return 1;	/* Kept for the next f_mount() */
 }
 
 
@@ -121,22 +119,27 @@ int ff_req_grant (	/* 1:Got a grant to access the volume, 0:Could not get a gran
 	FF_SYNC_t sobj	/* Sync object to wait */
 )
 {
-	/* Win32 */
-	return (int)(WaitForSingleObject(sobj, FF_FS_TIMEOUT) == WAIT_OBJECT_0);
-
-	/* uITRON */
-//	return (int)(wai_sem(sobj) == E_OK);
-
-	/* uC/OS-II */
-//	OS_ERR err;
-//	OSMutexPend(sobj, FF_FS_TIMEOUT, &err));
-//	return (int)(err == OS_NO_ERR);
-
-	/* FreeRTOS */
-//	return (int)(xSemaphoreTake(sobj, FF_FS_TIMEOUT) == pdTRUE);
-
-	/* CMSIS-RTOS */
-//	return (int)(osMutexWait(sobj, FF_FS_TIMEOUT) == osOK);
+	int vol = sobj - Mutex;
+	uint32_t t = time_us_32(), w = 0;
+	bool waited = false;
+
+	if (!recursive_mutex_try_enter(sobj, NULL)) {
+		if (!recursive_mutex_enter_timeout_ms(sobj, FF_FS_TIMEOUT)) {
+			Lock_timeouts[vol][get_core_num()]++;
+			return 0;
+		}
+		waited = true;
+		w = time_us_32() - t;
+	}
+
+	/* Statistics are only written by the holder */
+	if (waited) {
+		Lock_stat[vol].contended++;
+		if (w > Lock_stat[vol].wait_max) Lock_stat[vol].wait_max = w;
+	}
+	Lock_stat[vol].grants++;
+	if (sobj->enter_count == 1) Lock_stat[vol].since = time_us_32();
+	return 1;
 }
 
 
@@ -150,21 +153,37 @@ void ff_rel_grant (
 	FF_SYNC_t sobj	/* Sync object to be signaled */
 )
 {
-	/* Win32 */
-	ReleaseMutex(sobj);
-
-	/* uITRON */
-//	sig_sem(sobj);
+	int vol = sobj - Mutex;
+
+	if (sobj->enter_count == 1) {
+		uint32_t h = time_us_32() - Lock_stat[vol].since;
+		if (h > Lock_stat[vol].hold_max) Lock_stat[vol].hold_max = h;
+		Lock_stat[vol].hold_sum += h;
+		Lock_stat[vol].holds++;
+	}
+	recursive_mutex_exit(sobj);
+}
 
-	/* uC/OS-II */
-//	OSMutexPost(sobj);
 
-	/* FreeRTOS */
-//	xSemaphoreGive(sobj);
+/*------------------------------------------------------------------------*/
+/* Show and Restart the Lock Statistics                                   */
+/*------------------------------------------------------------------------*/
 
-	/* CMSIS-RTOS */
-//	osMutexRelease(sobj);
+void ff_lock_show (void)
+{
+	for (int vol = 0; vol < FF_VOLUMES; vol++) {
+		if (!Mutex_ready[vol]) continue;
+
+		recursive_mutex_enter_blocking(&Mutex[vol]);
+		uint32_t to = Lock_timeouts[vol][0] + Lock_timeouts[vol][1];
+		printf("fatfs vol %d grants %u contended %u timeouts %u wait max %u us hold max %u us avg %u us\n",
+			vol, Lock_stat[vol].grants, Lock_stat[vol].contended, to - Lock_stat[vol].timeouts_seen,
+			Lock_stat[vol].wait_max, Lock_stat[vol].hold_max,
+			Lock_stat[vol].holds ? Lock_stat[vol].hold_sum / Lock_stat[vol].holds : 0);
+		memset(&Lock_stat[vol], 0, sizeof Lock_stat[vol]);
+		Lock_stat[vol].timeouts_seen = to;
+		recursive_mutex_exit(&Mutex[vol]);
+	}
 }
 
 #endif
-
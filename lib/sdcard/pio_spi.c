@@ -6,9 +6,11 @@
 
 #include "pio_spi.h"
 
-// Just 8 bit functions provided here. The PIO program supports any frame size
-// 1...32, but the software to do the necessary FIFO shuffling is left as an
-// exercise for the reader :)
+// 8 and 32 bit functions are provided here, pio_spi_set_frame switches the
+// frame size. 32 bit frames go through the FIFO whole and are byte swapped so
+// the lowest address is sent first. DMA callers get 16 bit frames right with
+// halfword transfers and bswap: narrow writes are replicated into the upper
+// half, and the RX FIFO is read at its lower half.
 //
 // Likewise we only provide MSB-first here. To do LSB-first, you need to
 // - Do shifts when reading from the FIFO, for general case n != 8, 16, 32
@@ -81,4 +83,63 @@ void __time_critical_func(pio_spi_repeat8_read8_blocking)(const pio_spi_inst_t *
             --rx_remain;
         }
     }
-}
\ No newline at end of file
+}
+void __time_critical_func(pio_spi_write32_blocking)(const pio_spi_inst_t *spi, const uint32_t *src, size_t len) {
+    size_t tx_remain = len, rx_remain = len;
+    io_rw_32 *txfifo = &spi->pio->txf[spi->sm];
+    io_rw_32 *rxfifo = &spi->pio->rxf[spi->sm];
+    while (tx_remain || rx_remain) {
+        if (tx_remain && !pio_sm_is_tx_fifo_full(spi->pio, spi->sm)) {
+            *txfifo = __builtin_bswap32(*src++);
+            --tx_remain;
+        }
+        if (rx_remain && !pio_sm_is_rx_fifo_empty(spi->pio, spi->sm)) {
+            (void) *rxfifo;
+            --rx_remain;
+        }
+    }
+}
+
+void __time_critical_func(pio_spi_repeat32_read32_blocking)(const pio_spi_inst_t *spi, uint32_t src, uint32_t *dst,
+                                                           size_t len) {
+    size_t tx_remain = len, rx_remain = len;
+    io_rw_32 *txfifo = &spi->pio->txf[spi->sm];
+    io_rw_32 *rxfifo = &spi->pio->rxf[spi->sm];
+    while (tx_remain || rx_remain) {
+        if (tx_remain && !pio_sm_is_tx_fifo_full(spi->pio, spi->sm)) {
+            *txfifo = src;
+            --tx_remain;
+        }
+        if (rx_remain && !pio_sm_is_rx_fifo_empty(spi->pio, spi->sm)) {
+            *dst++ = __builtin_bswap32(*rxfifo);
+            --rx_remain;
+        }
+    }
+}
+
+void __time_critical_func(pio_spi_set_frame)(const pio_spi_inst_t *spi, uint n_bits, bool tx_only) {
+    uint offs = tx_only ? spi->tx_prog_offs : spi->prog_offs;
+    pio_sm_config c = tx_only ? spi_tx_program_get_default_config(offs) : spi_cpha0_program_get_default_config(offs);
+    sm_config_set_out_pins(&c, spi->pin_mosi, 1);
+    sm_config_set_in_pins(&c, spi->pin_miso);
+    sm_config_set_sideset_pins(&c, spi->pin_sck);
+    sm_config_set_out_shift(&c, false, true, n_bits);
+    sm_config_set_in_shift(&c, false, true, n_bits);
+    sm_config_set_clkdiv(&c, tx_only ? spi->tx_clkdiv : spi->clkdiv);
+
+    // pins keep their direction and function, pio_sm_init stops the state
+    // machine, clears the FIFOs and starts over at offs
+    pio_sm_init(spi->pio, spi->sm, offs, &c);
+    pio_sm_set_enabled(spi->pio, spi->sm, true);
+}
+
+// the TX FIFO is drained and the last bit shifted out. Once the FIFO is empty
+// the OSR holds at most one n_bits frame, so the rest is a fixed wait of that
+// many bit times; TXSTALL is sticky and may have been set before the caller
+// got here, or mid-transfer on an underflow, so it cannot mark the end.
+void __time_critical_func(pio_spi_wait_idle)(const pio_spi_inst_t *spi, uint n_bits) {
+    while (!pio_sm_is_tx_fifo_empty(spi->pio, spi->sm)) {
+        tight_loop_contents();
+    }
+    busy_wait_at_least_cycles((uint32_t)(2 * n_bits * spi->tx_clkdiv) + 2);
+}
@@ -13,8 +13,23 @@ typedef struct pio_spi_inst {
     PIO pio;
     uint sm;
     uint cs_pin;
+    // set up by the caller for pio_spi_set_frame
+    uint pin_sck, pin_mosi, pin_miso;
+    uint prog_offs;     // spi_cpha0
+    uint tx_prog_offs;  // spi_tx
+    float clkdiv;       // 4 cycles per bit
+    float tx_clkdiv;    // 2 cycles per bit
 } pio_spi_inst_t;
 
+// Reloads the state machine for n_bits frames (8, 16 or 32), full duplex or
+// transmit only. The state machine must be idle: nothing left in the TX FIFO
+// (pio_spi_wait_idle after transmit only) and the RX FIFO read.
+void pio_spi_set_frame(const pio_spi_inst_t *spi, uint n_bits, bool tx_only);
+
+// transmit only: returns after the last of n_bits frames has left, bounded by the
+// FIFO depth plus one frame at tx_clkdiv
+void pio_spi_wait_idle(const pio_spi_inst_t *spi, uint n_bits);
+
 void pio_spi_write8_blocking(const pio_spi_inst_t *spi, const uint8_t *src, size_t len);
 
 void pio_spi_read8_blocking(const pio_spi_inst_t *spi, uint8_t *dst, size_t len);
@@ -23,4 +38,9 @@ void pio_spi_write8_read8_blocking(const pio_spi_inst_t *spi, uint8_t *src, uint
 
 void pio_spi_repeat8_read8_blocking(const pio_spi_inst_t *spi, uint8_t src, uint8_t *dst, size_t len);
 
+// 32 bit frames, len in words; the first byte in memory is the first on the wire
+void pio_spi_write32_blocking(const pio_spi_inst_t *spi, const uint32_t *src, size_t len);
+
+void pio_spi_repeat32_read32_blocking(const pio_spi_inst_t *spi, uint32_t src, uint32_t *dst, size_t len);
+
 #endif
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "sdcard.h"
 
+#include <string.h>
+
 #include "pico.h"
 #include "pico/stdlib.h"
 #include "hardware/clocks.h"
@@ -8,7 +10,14 @@
 #else
 #include "pio_spi.h"
 #endif
+#ifdef SDCARD_SDIO
+#include "sdio.h"
+#endif
 #include "hardware/gpio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/structs/scb.h"
 //#include "hardware/gpio_ex.h"
 
 #include "ff.h"
@@ -24,6 +33,7 @@
 /* MMC/SD command */
 #define CMD0	(0)			/* GO_IDLE_STATE */
 #define CMD1	(1)			/* SEND_OP_COND (MMC) */
+#define CMD6	(6)			/* SWITCH_FUNC */
 #define	ACMD41	(0x80+41)	/* SEND_OP_COND (SDC) */
 #define CMD8	(8)			/* SEND_IF_COND */
 #define CMD9	(9)			/* SEND_CSD */
@@ -51,7 +61,28 @@
 #define CT_BLOCK       0x08            /* Block addressing */
 
 #define CLK_SLOW	(100 * KHZ)
-#define CLK_FAST	(30 * MHZ)
+#ifndef SDCARD_CLK_FAST
+#define SDCARD_CLK_FAST	(25 * MHZ)	/* SD default speed limit, the divider is derived from clk_peri */
+#endif
+#ifndef SDCARD_PIO_CLK
+#define SDCARD_PIO_CLK	SDCARD_CLK_FAST	/* PIO SPI limit, met with whole clock dividers */
+#endif
+#ifndef SDCARD_CLK_HS
+#define SDCARD_CLK_HS	(50 * MHZ)	/* SD high speed limit, after CMD6 */
+#endif
+#ifndef SDCARD_PIO_CLK_HS
+#define SDCARD_PIO_CLK_HS	SDCARD_CLK_HS
+#endif
+
+#ifndef SDCARD_DMA
+#define SDCARD_DMA	1	/* 1: data blocks are moved by DMA, paced by the SPI/PIO FIFOs */
+#endif
+#ifndef SDCARD_DMA_MIN
+#define SDCARD_DMA_MIN	64	/* Shorter transfers are cheaper done by the CPU */
+#endif
+
+static uint32_t clk_fast_hz;	/* Effective transfer clock */
+static bool hs_mode;		/* CMD6 switched to high speed and the read-back matched */
 
 static volatile
 DSTATUS Stat = STA_NOINIT;	/* Physical drive status */
@@ -59,10 +90,18 @@ DSTATUS Stat = STA_NOINIT;	/* Physical drive status */
 static
 BYTE CardType;			/* Card type flags */
 
+#ifdef SDCARD_SDIO
+static bool use_sdio;		/* Card runs on the 4-bit bus, the SPI block is left alone */
+static BYTE sdio_csd[16];	/* CSD read at initialization, CMD9 needs the card deselected */
+#endif
+
 #ifdef SDCARD_PIO
 pio_spi_inst_t pio_spi = {
 		.pio = SDCARD_PIO,
-		.sm = SDCARD_PIO_SM
+		.sm = SDCARD_PIO_SM,
+		.pin_sck = SDCARD_PIN_SPI0_SCK,
+		.pin_mosi = SDCARD_PIN_SPI0_MOSI,
+		.pin_miso = SDCARD_PIN_SPI0_MISO
 };
 #endif
 
@@ -91,13 +130,43 @@ static void FCLK_SLOW(void)
 {
 #ifndef SDCARD_PIO
     spi_set_baudrate(SDCARD_SPI_BUS, CLK_SLOW);
+#else
+    pio_spi.clkdiv = clock_get_hz(clk_sys) / (4.0f * CLK_SLOW);
+    pio_spi_set_frame(&pio_spi, 8, false);
+#endif
+}
+
+static void fclk_set(uint32_t hz)
+{
+#ifndef SDCARD_PIO
+    clk_fast_hz = spi_set_baudrate(SDCARD_SPI_BUS, hz);
+#else
+    /* Whole dividers keep SCK free of fractional jitter, rounded up to stay within the limit;
+       full duplex takes 4 SM cycles per bit, transmit only 2 */
+    uint32_t sys = clock_get_hz(clk_sys);
+    uint32_t div = (sys + 4 * hz - 1) / (4 * hz);
+    pio_spi.clkdiv = div;
+    pio_spi.tx_clkdiv = (sys + 2 * hz - 1) / (2 * hz);
+    pio_spi_set_frame(&pio_spi, 8, false);
+    clk_fast_hz = sys / (4 * div);
 #endif
 }
 
 static void FCLK_FAST(void)
 {
 #ifndef SDCARD_PIO
-    spi_set_baudrate(SDCARD_SPI_BUS, CLK_FAST);
+    fclk_set(SDCARD_CLK_FAST);
+#else
+    fclk_set(SDCARD_PIO_CLK);
+#endif
+}
+
+static void FCLK_HS(void)
+{
+#ifndef SDCARD_PIO
+    fclk_set(SDCARD_CLK_HS);
+#else
+    fclk_set(SDCARD_PIO_CLK_HS);
 #endif
 }
 
@@ -111,6 +180,202 @@ static void CS_LOW(void)
     cs_select(SDCARD_PIN_SPI0_CS);
 }
 
+#if SDCARD_DMA
+/*-----------------------------------------------------------------------*/
+/* DMA block transfers                                                   */
+/*-----------------------------------------------------------------------*/
+
+static int dma_tx = -1, dma_rx = -1;	/* Channels, -1: CPU transfers only */
+static volatile bool dma_done;
+static const uint32_t dma_fill = 0xFFFFFFFF;	/* Sent while receiving */
+static uint32_t dma_sink;			/* Received while transmitting */
+static const BYTE *dma_armed;		/* Block configured on the TX channel, not yet started */
+static uint dma_bits = 8;			/* Frame size of the armed transfer */
+static bool dma_tx_only;			/* Armed transfer runs the transmit only program */
+
+/* Completion callback, the RX channel is the last to finish; TX only raises it while nothing is received */
+static
+void __time_critical_func(dma_irq) (void)
+{
+	if (dma_channel_get_irq1_status(dma_rx)) {
+		dma_channel_acknowledge_irq1(dma_rx);
+		dma_done = true;
+		__sev();	/* Wake dma_wait */
+	}
+	if (dma_channel_get_irq1_status(dma_tx)) {
+		dma_channel_acknowledge_irq1(dma_tx);
+		dma_done = true;
+		__sev();
+	}
+}
+
+static
+void dma_init (void)
+{
+	if (dma_rx >= 0) return;	/* Kept across re-initialization */
+
+	dma_tx = dma_claim_unused_channel(false);
+	dma_rx = dma_claim_unused_channel(false);
+	if (dma_tx < 0 || dma_rx < 0) {
+		if (dma_tx >= 0) dma_channel_unclaim(dma_tx);
+		if (dma_rx >= 0) dma_channel_unclaim(dma_rx);
+		dma_tx = dma_rx = -1;
+		return;
+	}
+
+	dma_channel_set_irq1_enabled(dma_rx, true);
+	irq_add_shared_handler(DMA_IRQ_1, dma_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+	irq_set_enabled(DMA_IRQ_1, true);
+}
+
+/* Configure a transfer without starting it; tx 0 sends 0xFF, rx 0 discards the received bytes */
+static
+void __time_critical_func(dma_arm) (
+	const BYTE *tx,
+	BYTE *rx,
+	UINT len
+)
+{
+	dma_channel_config c;
+	enum dma_channel_transfer_size size = DMA_SIZE_8;
+	dma_bits = 8;
+	dma_tx_only = false;
+#ifndef SDCARD_PIO
+	volatile void *txf = &spi_get_hw(SDCARD_SPI_BUS)->dr;
+	const volatile void *rxf = &spi_get_hw(SDCARD_SPI_BUS)->dr;
+	uint tx_dreq = spi_get_dreq(SDCARD_SPI_BUS, true);
+	uint rx_dreq = spi_get_dreq(SDCARD_SPI_BUS, false);
+#else
+	/* Narrow writes are replicated, so 8 and 16 bit frames come out left-justified, and narrow
+	   reads pick the low end where they are pushed; bswap puts the first byte on the wire first */
+	volatile void *txf = &pio_spi.pio->txf[pio_spi.sm];
+	const volatile void *rxf = &pio_spi.pio->rxf[pio_spi.sm];
+	uint tx_dreq = pio_get_dreq(pio_spi.pio, pio_spi.sm, true);
+	uint rx_dreq = pio_get_dreq(pio_spi.pio, pio_spi.sm, false);
+	uintptr_t a = (uintptr_t)(tx ? tx : rx) | len;
+
+	if (!(a & 3)) {
+		dma_bits = 32; size = DMA_SIZE_32; len /= 4;
+	} else if (!(a & 1)) {
+		dma_bits = 16; size = DMA_SIZE_16; len /= 2;
+	}
+	dma_tx_only = tx && !rx;	/* Nothing to receive: two cycles per bit */
+#endif
+
+	if (!dma_tx_only) {
+		c = dma_channel_get_default_config(dma_rx);
+		channel_config_set_transfer_data_size(&c, size);
+		channel_config_set_read_increment(&c, false);
+		channel_config_set_write_increment(&c, rx != 0);
+		channel_config_set_dreq(&c, rx_dreq);
+		channel_config_set_bswap(&c, dma_bits != 8);
+		channel_config_set_high_priority(&c, true);	/* Keep the RX FIFO from overflowing */
+		dma_channel_configure(dma_rx, &c, rx ? (void *)rx : &dma_sink, rxf, len, false);
+	}
+
+	c = dma_channel_get_default_config(dma_tx);
+	channel_config_set_transfer_data_size(&c, size);
+	channel_config_set_read_increment(&c, tx != 0);
+	channel_config_set_write_increment(&c, false);
+	channel_config_set_dreq(&c, tx_dreq);
+	channel_config_set_bswap(&c, dma_bits != 8);
+	dma_channel_configure(dma_tx, &c, txf, tx ? (const void *)tx : &dma_fill, len, false);
+	dma_channel_set_irq1_enabled(dma_tx, dma_tx_only);
+	dma_armed = tx;
+}
+
+static
+void __time_critical_func(dma_go) (void)
+{
+	dma_armed = 0;
+	dma_done = false;
+#ifdef SDCARD_PIO
+	if (dma_bits != 8 || dma_tx_only) pio_spi_set_frame(&pio_spi, dma_bits, dma_tx_only);
+#endif
+	dma_start_channel_mask(dma_tx_only ? 1u << dma_tx : (1u << dma_tx) | (1u << dma_rx));
+}
+
+/* Sleep until the completion callback, interrupts are served meanwhile */
+static
+void __time_critical_func(dma_wait) (void)
+{
+	uint32_t scr = scb_hw->scr;
+	scb_hw->scr = scr & ~M0PLUS_SCR_SLEEPDEEP_BITS;	/* SPI and PIO clocks may be gated in deep sleep */
+	while (!dma_done) __wfe();
+	scb_hw->scr = scr;
+#ifdef SDCARD_PIO
+	if (dma_tx_only) pio_spi_wait_idle(&pio_spi, dma_bits);	/* The last words are still in the FIFO and OSR */
+	if (dma_bits != 8 || dma_tx_only) pio_spi_set_frame(&pio_spi, 8, false);
+#endif
+}
+#endif
+
+/*-----------------------------------------------------------------------*/
+/* Busy wait on DO                                                       */
+/*-----------------------------------------------------------------------*/
+
+#ifndef SDCARD_BUSY_POLL_US
+#define SDCARD_BUSY_POLL_US	1000	/* Clock DO at least this often while asleep, some cards need it to finish */
+#endif
+
+static volatile bool busy_end;
+
+/* DO went high: the card finished programming */
+static
+void __time_critical_func(busy_irq) (void)
+{
+	if (gpio_get_irq_event_mask(SDCARD_PIN_SPI0_MISO) & GPIO_IRQ_EDGE_RISE) {
+		gpio_acknowledge_irq(SDCARD_PIN_SPI0_MISO, GPIO_IRQ_EDGE_RISE);
+		busy_end = true;
+		__sev();	/* Wake busy_sleep */
+	}
+}
+
+static
+void busy_init (void)
+{
+	static bool added;
+
+	if (added) return;	/* Kept across re-initialization */
+	added = true;
+	gpio_add_raw_irq_handler(SDCARD_PIN_SPI0_MISO, busy_irq);
+	irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+/* The card holds DO low while busy, sleep until it lets go instead of clocking out 0xFF */
+static
+void busy_sleep (
+	absolute_time_t end	/* Give up at */
+)
+{
+	absolute_time_t t = make_timeout_time_us(SDCARD_BUSY_POLL_US);
+	if (absolute_time_diff_us(end, t) > 0) t = end;
+
+	busy_end = false;
+	gpio_acknowledge_irq(SDCARD_PIN_SPI0_MISO, GPIO_IRQ_EDGE_RISE);	/* Drop edges latched during transfers */
+	gpio_set_irq_enabled(SDCARD_PIN_SPI0_MISO, GPIO_IRQ_EDGE_RISE, true);
+	while (!busy_end && !gpio_get(SDCARD_PIN_SPI0_MISO)) {
+		if (best_effort_wfe_or_timeout(t)) break;
+	}
+	gpio_set_irq_enabled(SDCARD_PIN_SPI0_MISO, GPIO_IRQ_EDGE_RISE, false);
+}
+
+#ifdef SDCARD_SDIO
+/* DAT0 is DO: the same wait on the 4-bit bus */
+static
+int sdio_ready (	/* 1:Ready, 0:Timeout */
+	UINT wt			/* Timeout [ms] */
+)
+{
+	absolute_time_t end = make_timeout_time_ms(wt);
+
+	while (sdio_busy() && !time_reached(end)) busy_sleep(end);
+	return !sdio_busy();
+}
+#endif
+
+
+
 /* Initialize MMC interface */
 static
 void init_spi(void)
@@ -160,26 +425,35 @@ void init_spi(void)
     gpio_set_dir(SDCARD_PIN_SPI0_MISO, GPIO_OUT);
     gpio_set_dir(SDCARD_PIN_SPI0_MOSI, GPIO_OUT);
 
-	float clkdiv = 3.0f;
+	static bool loaded;	/* Programs are kept across re-initialization */
+	if (!loaded) {
+		pio_spi.prog_offs = pio_add_program(pio_spi.pio, &spi_cpha0_program);
+		pio_spi.tx_prog_offs = pio_add_program(pio_spi.pio, &spi_tx_program);
+		loaded = true;
+	}
+	pio_spi.clkdiv = clock_get_hz(clk_sys) / (4.0f * CLK_SLOW);
 	int cpol = 0;
 	int cpha = 0;
-	uint cpha0_prog_offs = pio_add_program(pio_spi.pio, &spi_cpha0_program);
 	pio_spi_init(pio_spi.pio, pio_spi.sm,
-				cpha0_prog_offs,
-				8,       // 8 bits per SPI frame
-				clkdiv,
+				pio_spi.prog_offs,
+				8,       // 8 bits per SPI frame, pio_spi_set_frame widens them for data blocks
+				pio_spi.clkdiv,
 				cpha,
 				cpol,
 				SDCARD_PIN_SPI0_SCK,
 				SDCARD_PIN_SPI0_MOSI,
 				SDCARD_PIN_SPI0_MISO
 	);
+#endif
+	busy_init();
+#if SDCARD_DMA
+	dma_init();
 #endif
 }
 
 /* Exchange a byte */
 static
-BYTE xchg_spi (
+BYTE __time_critical_func(xchg_spi) (
 	BYTE dat	/* Data to send */
 )
 {
@@ -195,16 +469,30 @@ BYTE xchg_spi (
 
 /* Receive multiple byte */
 static
-void rcvr_spi_multi (
+void __time_critical_func(rcvr_spi_multi) (
 	BYTE *buff,		/* Pointer to data buffer */
 	UINT btr		/* Number of bytes to receive (even number) */
 )
 {
 	uint8_t *b = (uint8_t *) buff;
+#if SDCARD_DMA
+	if (dma_rx >= 0 && btr >= SDCARD_DMA_MIN) {
+		dma_arm(0, b, btr);
+		dma_go();
+		dma_wait();
+		return;
+	}
+#endif
 #ifndef SDCARD_PIO
 	spi_read_blocking(SDCARD_SPI_BUS, 0xff, b, btr);
 #else
-	pio_spi_repeat8_read8_blocking(&pio_spi, 0xff, b, btr);
+	if (!(((uintptr_t)b | btr) & 3)) {	/* Whole words: a quarter of the FIFO accesses */
+		pio_spi_set_frame(&pio_spi, 32, false);
+		pio_spi_repeat32_read32_blocking(&pio_spi, 0xFFFFFFFF, (uint32_t *)b, btr / 4);
+		pio_spi_set_frame(&pio_spi, 8, false);
+	} else {
+		pio_spi_repeat8_read8_blocking(&pio_spi, 0xff, b, btr);
+	}
 #endif
 }
 
@@ -214,17 +502,16 @@ void rcvr_spi_multi (
 /*-----------------------------------------------------------------------*/
 
 static
-int wait_ready (	/* 1:Ready, 0:Timeout */
+int __time_critical_func(wait_ready) (	/* 1:Ready, 0:Timeout */
 	UINT wt			/* Timeout [ms] */
 )
 {
 	BYTE d;
+	absolute_time_t end = make_timeout_time_ms(wt);
 
-	uint32_t t = _millis();
-	do {
-		d = xchg_spi(0xFF);
-		/* This loop takes a time. Insert rot_rdq() here for multitask envilonment. */
-	} while (d != 0xFF && _millis() < t + wt);	/* Wait for card goes ready or timeout */
+	while ((d = xchg_spi(0xFF)) != 0xFF && !time_reached(end)) {	/* Wait for card goes ready or timeout */
+		busy_sleep(end);
+	}
 
 	return (d == 0xFF) ? 1 : 0;
 }
@@ -238,6 +525,9 @@ int wait_ready (	/* 1:Ready, 0:Timeout */
 static
 void deselect (void)
 {
+#ifdef SDCARD_SDIO
+	if (use_sdio) return;	/* No chip select on the 4-bit bus */
+#endif
 	CS_HIGH();		/* Set CS# high */
 	xchg_spi(0xFF);	/* Dummy clock (force DO hi-z for multiple slave SPI) */
 }
@@ -266,7 +556,7 @@ int _select (void)	/* 1:OK, 0:Timeout */
 /*-----------------------------------------------------------------------*/
 
 static
-int rcvr_datablock (	/* 1:OK, 0:Error */
+int __time_critical_func(rcvr_datablock) (	/* 1:OK, 0:Error */
 	BYTE *buff,			/* Data buffer */
 	UINT btr			/* Data block length (byte) */
 )
@@ -334,6 +624,84 @@ BYTE send_cmd (		/* Return value: R1 resp (bit7==1:Failed to send) */
 	return res;							/* Return received response */
 }
 
+
+
+/*-----------------------------------------------------------------------*/
+/* Sequential read stream                                                */
+/*-----------------------------------------------------------------------*/
+
+/* A CMD18 is left running while reads stay contiguous; the card then keeps
+   CS asserted between disk_read calls and any other access closes it first */
+static bool rd_open;		/* CMD18 in progress */
+static LBA_t rd_next;		/* Sector the stream delivers next */
+static uint32_t rd_ms;		/* Last block taken from it */
+
+static
+void stream_close (void)
+{
+	if (rd_open) {
+		rd_open = false;
+		send_cmd(CMD12, 0);		/* STOP_TRANSMISSION */
+		deselect();
+	}
+}
+
+/*-----------------------------------------------------------------------*/
+/* High speed switch                                                     */
+/*-----------------------------------------------------------------------*/
+
+static DWORD hs_buf[128];	/* Sector 0, read on both sides of the clock change */
+
+static
+int read_hash (	/* 1:OK, 0:Error */
+	DWORD *h	/* FNV-1a of sector 0 */
+)
+{
+	UINT i;
+	int ok = (send_cmd(CMD17, 0) == 0) && rcvr_datablock((BYTE *)hs_buf, 512);
+
+	deselect();
+	for (*h = 2166136261u, i = 0; i < 128; i++) *h = (*h ^ hs_buf[i]) * 16777619u;
+	return ok;
+}
+
+/* CMD6 on function group 1 (access mode) */
+static
+int switch_hs (	/* 1: high speed supported (check) or selected (switch) */
+	DWORD sw	/* 0: check, 1: switch */
+)
+{
+	BYTE st[64];	/* Switch function status */
+	int ok = (send_cmd(CMD6, sw << 31 | 0x00FFFFF1) == 0) && rcvr_datablock(st, 64)
+		&& (sw ? (st[16] & 0x0F) == 1 : (st[13] & 0x02) != 0);
+
+	deselect();
+	return ok;
+}
+
+/* Move to high speed where the card has it and the clock gains, checked by
+   reading sector 0 again at the new clock */
+static
+void high_speed (void)
+{
+	DWORD h0, h1;
+	uint32_t fast = clk_fast_hz;
+
+	FCLK_HS();
+	if (clk_fast_hz <= fast) {	/* No faster divider at this clk_sys */
+		FCLK_FAST();
+		return;
+	}
+	FCLK_FAST();
+	if (!switch_hs(0) || !read_hash(&h0) || !switch_hs(1)) return;
+	FCLK_HS();
+	if (read_hash(&h1) && h1 == h0) {
+		hs_mode = true;
+		return;
+	}
+	FCLK_FAST();	/* The card stays in high speed, which holds at the default clock too */
+}
+
 /*--------------------------------------------------------------------------
 
    Public Functions
@@ -352,9 +720,28 @@ DSTATUS disk_initialize (
 	BYTE n, cmd, ty, ocr[4];
 	const uint32_t timeout = 1000; /* Initialization timeout = 1 sec */
 	uint32_t t;
+#ifdef SDCARD_SDIO
+	int v2, ba;
+#endif
 
 
 	if (drv) return STA_NOINIT;			/* Supports only drive 0 */
+	if (!(Stat & STA_NOINIT)) stream_close();	/* Remount, end an open CMD18 while the bus still runs */
+	rd_open = false;					/* The card is reset below */
+	hs_mode = false;
+#ifdef SDCARD_SDIO
+	busy_init();
+	if (sdio_init(&v2, &ba, sdio_csd)) {	/* 4-bit SD bus first */
+		use_sdio = true;
+		CardType = (v2 ? CT_SD2 : CT_SD1) | (ba ? CT_BLOCK : 0);
+		clk_fast_hz = sdio_clock_hz();
+		hs_mode = sdio_high_speed();
+		Stat &= ~STA_NOINIT;
+		return Stat;
+	}
+	use_sdio = false;
+	sdio_deinit();						/* SPI on the same wires, CMD0 with CS (DAT3) low switches the card over */
+#endif
 	init_spi();							/* Initialize SPI */
     sleep_ms(10);
 
@@ -392,6 +779,7 @@ DSTATUS disk_initialize (
 
 	if (ty) {			/* OK */
 		FCLK_FAST();			/* Set fast clock */
+		if (ty & CT_SD2) high_speed();	/* CMD6 came with SD ver 1.10, every SDv2 card has it */
 		Stat &= ~STA_NOINIT;	/* Clear STA_NOINIT flag */
 	} else {			/* Failed */
 		Stat = STA_NOINIT;
@@ -417,6 +805,39 @@ DSTATUS disk_status (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Close a read stream that went quiet                                   */
+/*-----------------------------------------------------------------------*/
+
+int sdcard_stream_poll (void)
+{
+	if (rd_open && _millis() - rd_ms >= SDCARD_STREAM_IDLE_MS) stream_close();
+
+	return rd_open;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Get the effective transfer clock and mode                             */
+/*-----------------------------------------------------------------------*/
+
+uint32_t sdcard_clock_hz (void)
+{
+	return clk_fast_hz;
+}
+
+const char *sdcard_mode (void)
+{
+	if (Stat & STA_NOINIT) return "none";
+#ifdef SDCARD_SDIO
+	if (use_sdio) return hs_mode ? "4-bit high speed" : "4-bit";
+#endif
+	return hs_mode ? "spi high speed" : "spi";
+}
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Read sector(s)                                                        */
 /*-----------------------------------------------------------------------*/
@@ -431,24 +852,35 @@ DRESULT disk_read (
 	if (drv || !count) return RES_PARERR;		/* Check parameter */
 	if (Stat & STA_NOINIT) return RES_NOTRDY;	/* Check if drive is ready */
 
-	if (!(CardType & CT_BLOCK)) sector *= 512;	/* LBA ot BA conversion (byte addressing cards) */
-
-	if (count == 1) {	/* Single sector read */
-		if ((send_cmd(CMD17, sector) == 0)	/* READ_SINGLE_BLOCK */
-			&& rcvr_datablock(buff, 512)) {
-			count = 0;
-		}
+#ifdef SDCARD_SDIO
+	if (use_sdio) {
+		do {
+			if (!sdio_ready(500) || !sdio_read_block(buff, (CardType & CT_BLOCK) ? sector : sector * 512)) break;
+			buff += 512;
+			sector++;
+		} while (--count);
+		return count ? RES_ERROR : RES_OK;
 	}
-	else {				/* Multiple sector read */
-		if (send_cmd(CMD18, sector) == 0) {	/* READ_MULTIPLE_BLOCK */
-			do {
-				if (!rcvr_datablock(buff, 512)) break;
-				buff += 512;
-			} while (--count);
-			send_cmd(CMD12, 0);				/* STOP_TRANSMISSION */
+#endif
+	if (rd_open && sector != rd_next) stream_close();	/* Not sequential */
+
+	if (!rd_open) {
+		if (send_cmd(CMD18, (CardType & CT_BLOCK) ? sector : sector * 512) != 0) {	/* READ_MULTIPLE_BLOCK, LBA ot BA conversion */
+			deselect();
+			return RES_ERROR;
 		}
+		rd_open = true;
+		rd_next = sector;
 	}
-	deselect();
+
+	do {
+		if (!rcvr_datablock(buff, 512)) break;
+		buff += 512;
+		rd_next++;
+	} while (--count);
+	rd_ms = _millis();
+
+	if (count) stream_close();		/* Start over with a fresh command on the next read */
 
 	return count ? RES_ERROR : RES_OK;	/* Return result */
 }
@@ -466,16 +898,30 @@ DWORD get_fattime (void)
 #if FF_FS_READONLY == 0
 /* Transmit multiple byte */
 static
-void xmit_spi_multi (
+void __time_critical_func(xmit_spi_multi) (
 	const BYTE *buff,		/* Pointer to data buffer */
 	UINT btx		/* Number of bytes to transmit (even number) */
 )
 {
 	const uint8_t *b = (const uint8_t *) buff;
+#if SDCARD_DMA
+	if (dma_tx >= 0 && btx >= SDCARD_DMA_MIN) {
+		if (dma_armed != b) dma_arm(b, 0, btx);	/* Not prepared by xmit_datablock */
+		dma_go();
+		dma_wait();
+		return;
+	}
+#endif
 #ifndef SDCARD_PIO
 	spi_write_blocking(SDCARD_SPI_BUS, b, btx);
 #else
-	pio_spi_write8_blocking(&pio_spi, b, btx);
+	if (!(((uintptr_t)b | btx) & 3)) {
+		pio_spi_set_frame(&pio_spi, 32, false);
+		pio_spi_write32_blocking(&pio_spi, (const uint32_t *)b, btx / 4);
+		pio_spi_set_frame(&pio_spi, 8, false);
+	} else {
+		pio_spi_write8_blocking(&pio_spi, b, btx);
+	}
 #endif
 }
 
@@ -484,13 +930,16 @@ void xmit_spi_multi (
 /*-----------------------------------------------------------------------*/
 
 static
-int xmit_datablock (	/* 1:OK, 0:Error */
+int __time_critical_func(xmit_datablock) (	/* 1:OK, 0:Error */
 	const BYTE *buff, /* 512 byte data block to be transmitted */
 	BYTE token /* Data/Stop token */
 )
 {
 	BYTE resp;
-	if (!wait_ready(500)) return 0;
+#if SDCARD_DMA
+	if (token != 0xFD && dma_tx >= 0) dma_arm(buff, 0, 512);	/* Ready to go the moment the card is */
+#endif
+	if (!wait_ready(500)) return 0;	/* The previous block is being programmed */
 	xchg_spi(token); /* Xmit data token */
 	if (token != 0xFD) { /* Is data token */
 		xmit_spi_multi(buff, 512); /* Xmit the data block to the MMC */
@@ -517,11 +966,22 @@ DRESULT disk_write (
 	if (drv || !count) return RES_PARERR;		/* Check parameter */
 	if (Stat & STA_NOINIT) return RES_NOTRDY;	/* Check drive status */
 	if (Stat & STA_PROTECT) return RES_WRPRT;	/* Check write protect */
-
+	stream_close();
+
+#ifdef SDCARD_SDIO
+	if (use_sdio) {		/* One CMD24 per block, the last one is left programming */
+		do {
+			if (!sdio_ready(500) || !sdio_write_block(buff, (CardType & CT_BLOCK) ? sector : sector * 512)) break;
+			buff += 512;
+			sector++;
+		} while (--count);
+		return count ? RES_ERROR : RES_OK;
+	}
+#endif
 	if (!(CardType & CT_BLOCK)) sector *= 512;	/* LBA ==> BA conversion (byte addressing cards) */
 
-	if (!_select()) return RES_NOTRDY;
-
+	/* send_cmd selects the card; each block is armed before the busy wait on the one before it
+	   and the last one is left programming while the caller goes on */
 	if (count == 1) {	/* Single sector write */
 		if ((send_cmd(CMD24, sector) == 0)	/* WRITE_BLOCK */
 			&& xmit_datablock(buff, 0xFE)) {
@@ -545,6 +1005,25 @@ DRESULT disk_write (
 #endif
 
 
+/*-----------------------------------------------------------------------*/
+/* Read the CSD register                                                 */
+/*-----------------------------------------------------------------------*/
+
+static
+int read_csd (	/* 1:OK, 0:Error */
+	BYTE *csd	/* 16 bytes */
+)
+{
+#ifdef SDCARD_SDIO
+	if (use_sdio) {
+		memcpy(csd, sdio_csd, 16);
+		return 1;
+	}
+#endif
+	return (send_cmd(CMD9, 0) == 0) && rcvr_datablock(csd, 16);
+}
+
+
 /*-----------------------------------------------------------------------*/
 /* Miscellaneous drive controls other than data read/write               */
 /*-----------------------------------------------------------------------*/
@@ -563,15 +1042,22 @@ DRESULT disk_ioctl (
 	if (drv) return RES_PARERR;					/* Check parameter */
 	if (Stat & STA_NOINIT) return RES_NOTRDY;	/* Check if drive is ready */
 
+	stream_close();
 	res = RES_ERROR;
 
 	switch (cmd) {
 	case CTRL_SYNC :		/* Wait for end of internal write process of the drive */
+#ifdef SDCARD_SDIO
+		if (use_sdio) {
+			if (sdio_ready(500)) res = RES_OK;
+			break;
+		}
+#endif
 		if (_select()) res = RES_OK;
 		break;
 
 	case GET_SECTOR_COUNT :	/* Get drive capacity in unit of sector (DWORD) */
-		if ((send_cmd(CMD9, 0) == 0) && rcvr_datablock(csd, 16)) {
+		if (read_csd(csd)) {
 			if ((csd[0] >> 6) == 1) {	/* SDC ver 2.00 */
 				csize = csd[9] + ((WORD)csd[8] << 8) + ((DWORD)(csd[7] & 63) << 16) + 1;
 				*(DWORD*)buff = csize << 10;
@@ -585,6 +1071,9 @@ DRESULT disk_ioctl (
 		break;
 
 	case GET_BLOCK_SIZE :	/* Get erase block size in unit of sector (DWORD) */
+#ifdef SDCARD_SDIO
+		if (use_sdio) break;	/* SD status and erase are not wired up on the 4-bit bus */
+#endif
 		if (CardType & CT_SD2) {	/* SDC ver 2.00 */
 			if (send_cmd(ACMD13, 0) == 0) {	/* Read SD status */
 				xchg_spi(0xFF);
@@ -607,6 +1096,9 @@ DRESULT disk_ioctl (
 		break;
 
 	case CTRL_TRIM :	/* Erase a block of sectors (used when _USE_ERASE == 1) */
+#ifdef SDCARD_SDIO
+		if (use_sdio) break;
+#endif
 		if (!(CardType & CT_SDC)) break;				/* Check if the card is SDC */
 		if (disk_ioctl(drv, MMC_GET_CSD, csd)) break;	/* Get CSD */
 		if (!(csd[0] >> 6) && !(csd[10] & 0x40)) break;	/* Check if sector erase can be applied to the card */
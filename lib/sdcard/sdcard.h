@@ -1,6 +1,22 @@
 #ifndef _SDCARD_H_
 #define _SDCARD_H_
 
+/* 4-bit SD bus (SDCARD_SDIO): CLK, CMD and DAT0..DAT3 on consecutive pins
+   from SDCARD_PIN_SDIO_CLK, tried before SPI. The SPI fallback runs on the
+   same wires: SCK on CLK, MOSI on CMD, MISO on DAT0, CS on DAT3. With the
+   SPI block, CLK must be an SCK pin with TX and RX after it (2 or 18 on
+   spi0); SDCARD_PIO takes any pins. */
+
+#ifdef SDCARD_SDIO
+#ifndef SDCARD_PIN_SDIO_CLK
+#error "SDCARD_SDIO needs SDCARD_PIN_SDIO_CLK"
+#endif
+#define SDCARD_PIN_SPI0_SCK    SDCARD_PIN_SDIO_CLK
+#define SDCARD_PIN_SPI0_MOSI   (SDCARD_PIN_SDIO_CLK + 1)
+#define SDCARD_PIN_SPI0_MISO   (SDCARD_PIN_SDIO_CLK + 2)
+#define SDCARD_PIN_SPI0_CS     (SDCARD_PIN_SDIO_CLK + 5)
+#endif
+
 /* SPI pin assignment */
 
 #ifndef SDCARD_SPI_BUS
@@ -23,4 +39,14 @@
 #define SDCARD_PIN_SPI0_MISO   16
 #endif
 
+#ifndef SDCARD_STREAM_IDLE_MS
+#define SDCARD_STREAM_IDLE_MS  20	/* an open sequential read is stopped after this long unused */
+#endif
+
+#include "pico/types.h"
+
+uint32_t sdcard_clock_hz(void);	/* transfer clock after disk_initialize, 0 before */
+const char *sdcard_mode(void);	/* bus and speed mode: "spi", "spi high speed", "4-bit", "4-bit high speed" or "none" */
+int sdcard_stream_poll(void);	/* stops a quiet read stream, 1 while one stays open; call between FatFs calls */
+
 #endif // _SDCARD_H_
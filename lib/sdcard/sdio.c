@@ -0,0 +1,568 @@
+/*------------------------------------------------------------------------/
+/  4-bit SD bus over PIO for the RP2040
+/-------------------------------------------------------------------------/
+/  CLK is a PWM output; one state machine sends commands and reads their
+/  responses, two more move data blocks on DAT0..DAT3 with DMA. Blocks are
+/  taken one per command (CMD17/CMD24): the clock cannot be paused, so a
+/  block must be wholly in memory before its first nibble goes out and the
+/  next one cannot be waited for. CRC7 and the CRC16 of each data line are
+/  checked in software, the DMA sniffer only knows whole bytes.
+/------------------------------------------------------------------------*/
+
+#include "sdcard.h"
+
+#ifdef SDCARD_SDIO
+
+#include "sdio.h"
+
+#include "pico.h"
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/pio.h"
+#include "hardware/pwm.h"
+#include "sdio.pio.h"
+
+
+#define PIN_CLK		SDCARD_PIN_SDIO_CLK
+#define PIN_CMD		(PIN_CLK + 1)
+#define PIN_D0		(PIN_CLK + 2)
+
+#define CLK_INIT	(400 * KHZ)		/* Identification mode limit */
+
+/* SD command */
+#define CMD0	(0)			/* GO_IDLE_STATE */
+#define CMD2	(2)			/* ALL_SEND_CID */
+#define CMD3	(3)			/* SEND_RELATIVE_ADDR */
+#define CMD6	(6)			/* SWITCH_FUNC */
+#define ACMD6	(0x80+6)	/* SET_BUS_WIDTH */
+#define CMD7	(7)			/* SELECT_CARD */
+#define CMD8	(8)			/* SEND_IF_COND */
+#define CMD9	(9)			/* SEND_CSD */
+#define CMD16	(16)		/* SET_BLOCKLEN */
+#define CMD17	(17)		/* READ_SINGLE_BLOCK */
+#define CMD24	(24)		/* WRITE_BLOCK */
+#define	ACMD41	(0x80+41)	/* SD_SEND_OP_COND */
+#define CMD55	(55)		/* APP_CMD */
+
+#define R1_ERRORS	0xFDF80008	/* Card status error bits */
+#define CMD_TIMEOUT	10			/* [ms], N_CR is 64 clocks at most */
+#define DATA_TIMEOUT	250		/* [ms], read and write access time limits */
+
+#define RX_NIBBLES	(512 * 2 + 16)			/* Block and the CRC16 of each line */
+#define TX_NIBBLES	(8 + RX_NIBBLES)		/* Lead-in word before them */
+
+static int sm_cmd = -1, sm_rx, sm_tx;	/* Claimed once, kept across re-initialization */
+static uint off_cmd, off_rx, off_tx;
+static int dma_ch;
+static uint32_t blk[2 + RX_NIBBLES / 8];	/* Block in bus order, the first nibble in the top bits */
+static uint16_t rca;		/* Relative card address */
+static uint32_t clk_hz;
+static bool hs;				/* High speed timing */
+static uint32_t crc_errors;
+
+
+/*-----------------------------------------------------------------------*/
+/* CRC                                                                   */
+/*-----------------------------------------------------------------------*/
+
+/* CRC7 of a command or response, MSB first */
+static
+uint8_t crc7 (
+	const uint8_t *p,
+	uint n
+)
+{
+	uint8_t crc = 0, fb, d;
+	int i;
+
+	while (n--) {
+		for (d = *p++, i = 0; i < 8; i++, d <<= 1) {
+			fb = ((crc >> 6) ^ (d >> 7)) & 1;
+			crc = (crc << 1) & 0x7F;
+			if (fb) crc ^= 0x09;
+		}
+	}
+	return crc;
+}
+
+/* CRC16 (x^16+x^12+x^5+1) of each data line at once: nibble k holds bit k
+   of all four, so one step per clock shifts the nibbles and feeds back the
+   top one at taps 0, 5 and 12. The result is the CRC as sent, first nibble
+   in the top bits. */
+static
+uint64_t __time_critical_func(crc16_4) (
+	const uint32_t *w,	/* Words in bus order */
+	uint n
+)
+{
+	uint64_t crc = 0, fb;
+	uint32_t d;
+	int i;
+
+	while (n--) {
+		for (d = *w++, i = 0; i < 8; i++, d <<= 4) {
+			fb = (crc >> 60) ^ (d >> 28);
+			crc = (crc << 4) ^ fb ^ (fb << 20) ^ (fb << 48);
+		}
+	}
+	return crc;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* Clock and state machines                                              */
+/*-----------------------------------------------------------------------*/
+
+/* CLK period: an even number of whole clk_sys cycles, at least 6 so the
+   state machines see each half */
+static
+uint32_t clk_period (
+	uint32_t hz		/* Limit */
+)
+{
+	uint32_t period = (clock_get_hz(clk_sys) + hz - 1) / hz;
+
+	period = (period + 1) & ~1u;
+	if (period < 6) period = 6;
+	if (period > 65536) period = 65536;
+	return period;
+}
+
+/* CLK from its PWM slice */
+static
+void clk_set (
+	uint32_t hz		/* Limit */
+)
+{
+	uint slice = pwm_gpio_to_slice_num(PIN_CLK);
+	uint32_t period = clk_period(hz);
+
+	pwm_set_clkdiv_int_frac(slice, 1, 0);
+	pwm_set_wrap(slice, period - 1);
+	pwm_set_gpio_level(PIN_CLK, period / 2);
+	pwm_set_enabled(slice, true);
+	clk_hz = clock_get_hz(clk_sys) / period;
+}
+
+static
+void cmd_reset (void)
+{
+	pio_sm_set_enabled(SDCARD_SDIO_PIO_CMD, sm_cmd, false);
+	pio_sm_clear_fifos(SDCARD_SDIO_PIO_CMD, sm_cmd);
+	pio_sm_restart(SDCARD_SDIO_PIO_CMD, sm_cmd);
+	pio_sm_exec(SDCARD_SDIO_PIO_CMD, sm_cmd, pio_encode_set(pio_pindirs, 0));
+	pio_sm_exec(SDCARD_SDIO_PIO_CMD, sm_cmd, pio_encode_jmp(off_cmd));
+	pio_sm_set_enabled(SDCARD_SDIO_PIO_CMD, sm_cmd, true);
+}
+
+/* Abandon a data transfer, the lines are released */
+static
+void data_reset (void)
+{
+	PIO pio = SDCARD_SDIO_PIO_DATA;
+
+	dma_channel_abort(dma_ch);
+	pio_set_sm_mask_enabled(pio, (1u << sm_rx) | (1u << sm_tx), false);
+	pio_sm_clear_fifos(pio, sm_rx);
+	pio_sm_clear_fifos(pio, sm_tx);
+	pio_restart_sm_mask(pio, (1u << sm_rx) | (1u << sm_tx));
+	pio_sm_exec(pio, sm_tx, pio_encode_set(pio_pindirs, 0));
+	pio_sm_exec(pio, sm_tx, pio_encode_set(pio_pins, 15));
+	pio_sm_exec(pio, sm_rx, pio_encode_jmp(off_rx));
+	pio_sm_exec(pio, sm_tx, pio_encode_jmp(off_tx));
+	pio_set_sm_mask_enabled(pio, (1u << sm_rx) | (1u << sm_tx), true);
+}
+
+/* Claim the state machines and the DMA channel and load the programs, once */
+static
+int setup (void)
+{
+	/* Both data programs as one, pio_can_add_program checks a single program */
+	static const uint16_t data_insns[count_of(sdio_data_rx_program_instructions)
+			+ count_of(sdio_data_tx_program_instructions)];
+	static const pio_program_t data_progs = {
+		.instructions = data_insns, .length = count_of(data_insns), .origin = -1
+	};
+	int rx, tx, cmd, ch;
+#ifdef SDCARD_PIO
+	int spi = 0;
+#endif
+
+
+	if (sm_cmd >= 0) return 1;
+
+	/* Everything is checked before anything is claimed, pio_add_program panics when full */
+	if (SDCARD_SDIO_PIO_CMD == SDCARD_SDIO_PIO_DATA) return 0;	/* 45 instructions, no room in one */
+	if (!pio_can_add_program(SDCARD_SDIO_PIO_CMD, &sdio_cmd_program)) return 0;
+	if (!pio_can_add_program(SDCARD_SDIO_PIO_DATA, &data_progs)) return 0;
+
+#ifdef SDCARD_PIO
+	if (!pio_sm_is_claimed(SDCARD_PIO, SDCARD_PIO_SM)) {
+		pio_sm_claim(SDCARD_PIO, SDCARD_PIO_SM);	/* Kept for the SPI fallback */
+		spi = 1;
+	}
+#endif
+	ch = dma_claim_unused_channel(false);
+	rx = pio_claim_unused_sm(SDCARD_SDIO_PIO_DATA, false);
+	tx = pio_claim_unused_sm(SDCARD_SDIO_PIO_DATA, false);
+	cmd = pio_claim_unused_sm(SDCARD_SDIO_PIO_CMD, false);
+	if (ch < 0 || rx < 0 || tx < 0 || cmd < 0) {
+		if (ch >= 0) dma_channel_unclaim(ch);
+		if (rx >= 0) pio_sm_unclaim(SDCARD_SDIO_PIO_DATA, rx);
+		if (tx >= 0) pio_sm_unclaim(SDCARD_SDIO_PIO_DATA, tx);
+		if (cmd >= 0) pio_sm_unclaim(SDCARD_SDIO_PIO_CMD, cmd);
+#ifdef SDCARD_PIO
+		if (spi) pio_sm_unclaim(SDCARD_PIO, SDCARD_PIO_SM);
+#endif
+		return 0;
+	}
+	off_cmd = pio_add_program(SDCARD_SDIO_PIO_CMD, &sdio_cmd_program);
+	off_rx = pio_add_program(SDCARD_SDIO_PIO_DATA, &sdio_data_rx_program);
+	off_tx = pio_add_program(SDCARD_SDIO_PIO_DATA, &sdio_data_tx_program);
+	dma_ch = ch;
+	sm_rx = rx;
+	sm_tx = tx;
+	sm_cmd = cmd;	/* Last, it marks the setup done */
+	return 1;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* Commands                                                              */
+/*-----------------------------------------------------------------------*/
+
+/* Send a command and collect a response of bits (0: none expected) */
+static
+int cmd_xfer (	/* 1: response received */
+	uint8_t cmd,
+	uint32_t arg,
+	uint bits,
+	uint32_t *r		/* (bits + 31) / 32 words, the last right-justified */
+)
+{
+	PIO pio = SDCARD_SDIO_PIO_CMD;
+	uint8_t p[5] = { 0x40 | cmd, arg >> 24, arg >> 16, arg >> 8, arg };
+	uint n = 0;
+	absolute_time_t end = make_timeout_time_ms(CMD_TIMEOUT);
+
+	pio_sm_put(pio, sm_cmd, 47u << 24 | (bits ? bits - 2 : 0) << 16 | p[0] << 8 | p[1]);
+	pio_sm_put(pio, sm_cmd, (uint32_t)p[2] << 24 | p[3] << 16 | p[4] << 8 | crc7(p, 5) << 1 | 1);
+
+	if (!bits) {	/* Start over once the end bit is out */
+		while (pio_sm_get_pc(pio, sm_cmd) < off_cmd + sdio_cmd_offset_wait_start && !time_reached(end)) ;
+		cmd_reset();
+		return 1;
+	}
+	while (n < (bits + 31) / 32) {
+		if (!pio_sm_is_rx_fifo_empty(pio, sm_cmd)) {
+			r[n++] = pio_sm_get(pio, sm_cmd);
+		} else if (time_reached(end)) {
+			cmd_reset();	/* No card, or it did not take the command */
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Send a command with a 48 bit response (R1, R3, R6, R7) */
+static
+int send_cmd (	/* 1: answered intact */
+	uint8_t cmd,		/* Command index, 0x80 for an application command */
+	uint32_t arg,
+	uint32_t *resp		/* The 32 bit field */
+)
+{
+	uint32_t r[2];
+	uint8_t p[5];
+
+	if (cmd & 0x80) {	/* Send a CMD55 prior to ACMD<n> */
+		cmd &= 0x7F;
+		if (!send_cmd(CMD55, (uint32_t)rca << 16, resp) || (*resp & R1_ERRORS)) return 0;
+	}
+	if (!cmd_xfer(cmd, arg, 48, r)) return 0;
+
+	*resp = r[0] << 8 | (r[1] >> 8 & 0xFF);
+	if (!(r[1] & 1)) return 0;				/* End bit */
+	if (cmd == (ACMD41 & 0x7F)) return 1;	/* R3 carries neither index nor CRC */
+	p[0] = r[0] >> 24; p[1] = r[0] >> 16; p[2] = r[0] >> 8; p[3] = r[0]; p[4] = r[1] >> 8;
+	if (crc7(p, 5) != (r[1] >> 1 & 0x7F)) {
+		crc_errors++;
+		return 0;
+	}
+	return (p[0] & 0x3F) == cmd;
+}
+
+/* Send a command with a 136 bit response (R2), the register goes to reg[16] */
+static
+int send_cmd_r2 (
+	uint8_t cmd,
+	uint32_t arg,
+	uint8_t *reg
+)
+{
+	uint32_t r[5];
+	int i;
+
+	if (!cmd_xfer(cmd, arg, 136, r)) return 0;
+	for (i = 0; i < 15; i++) reg[i] = r[(i + 1) / 4] >> (8 * (3 - (i + 1) % 4));
+	reg[15] = r[4];		/* CRC7 and end bit, as in the SPI mode register */
+	if (crc7(reg, 15) != reg[15] >> 1) {
+		crc_errors++;
+		return 0;
+	}
+	return 1;
+}
+
+static
+int wait_busy (
+	uint32_t ms
+)
+{
+	absolute_time_t end = make_timeout_time_ms(ms);
+
+	while (sdio_busy()) {
+		if (time_reached(end)) return 0;
+	}
+	return 1;
+}
+
+
+/* Send a command that reads a data block into blk, CRC checked */
+static
+int __time_critical_func(read_data) (
+	uint8_t cmd,
+	uint32_t arg,
+	uint n			/* Words, 128 for a sector */
+)
+{
+	PIO pio = SDCARD_SDIO_PIO_DATA;
+	dma_channel_config c = dma_channel_get_default_config(dma_ch);
+	absolute_time_t end;
+	uint32_t st;
+
+	/* Armed before the command, the block may start right after the response */
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+	channel_config_set_read_increment(&c, false);
+	channel_config_set_write_increment(&c, true);
+	channel_config_set_dreq(&c, pio_get_dreq(pio, sm_rx, false));
+	channel_config_set_high_priority(&c, true);
+	dma_channel_configure(dma_ch, &c, blk, &pio->rxf[sm_rx], n + 2, true);
+	pio_sm_put(pio, sm_rx, n * 8 + 16 - 1);
+
+	if (!send_cmd(cmd, arg, &st) || (st & R1_ERRORS)) {
+		data_reset();
+		return 0;
+	}
+	end = make_timeout_time_ms(DATA_TIMEOUT);
+	while (dma_channel_is_busy(dma_ch)) {
+		if (time_reached(end)) {
+			data_reset();
+			return 0;
+		}
+	}
+	if (crc16_4(blk, n) != ((uint64_t)blk[n] << 32 | blk[n + 1])) {
+		crc_errors++;
+		return 0;
+	}
+	return 1;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* High speed                                                            */
+/*-----------------------------------------------------------------------*/
+
+static
+uint32_t blk_hash (void)
+{
+	uint32_t h = 2166136261u;	/* FNV-1a over the words of a sector */
+	int i;
+
+	for (i = 0; i < 128; i++) h = (h ^ blk[i]) * 16777619u;
+	return h;
+}
+
+/* Switch function group 1 to high speed with CMD6 and raise CLK; sector 0
+   read again at the new clock must match. A high speed card changes its
+   outputs just after CLK rises, where the state machines sample, so CLK is
+   inverted on its way into PIO: they then drive after the rising edge and
+   sample after the falling one, which suits either card timing. */
+static
+int high_speed (void)	/* 1: running at SDCARD_SDIO_CLK_HS */
+{
+	uint32_t h;
+
+	if (clock_get_hz(clk_sys) / clk_period(SDCARD_SDIO_CLK_HS) <= clk_hz) return 0;	/* No faster here */
+	if (!read_data(CMD6, 0x00FFFFF1, 16) || !(blk[3] & 0x00020000)) return 0;	/* Check: byte 13 bit 1 */
+	if (!read_data(CMD17, 0, 128)) return 0;
+	h = blk_hash();
+	if (!read_data(CMD6, 0x80FFFFF1, 16) || (blk[4] >> 24 & 0x0F) != 1) return 0;	/* Switch: byte 16 */
+
+	gpio_set_inover(PIN_CLK, GPIO_OVERRIDE_INVERT);
+	clk_set(SDCARD_SDIO_CLK_HS);
+	if (read_data(CMD17, 0, 128) && blk_hash() == h) return 1;
+	clk_set(SDCARD_SDIO_CLK);	/* The card stays in high speed, fine at the default clock */
+	return 0;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* Public functions                                                      */
+/*-----------------------------------------------------------------------*/
+
+int sdio_init (
+	int *v2,		/* SD ver 2 */
+	int *block,		/* Block addressing */
+	uint8_t *csd	/* 16 bytes */
+)
+{
+	PIO pc = SDCARD_SDIO_PIO_CMD, pd = SDCARD_SDIO_PIO_DATA;
+	uint32_t st, ocr;
+	absolute_time_t end;
+	int i;
+
+	hs = false;
+	if (!setup()) return 0;
+
+	gpio_set_function(PIN_CLK, GPIO_FUNC_PWM);
+	gpio_set_inover(PIN_CLK, GPIO_OVERRIDE_NORMAL);
+	clk_set(CLK_INIT);
+	pio_gpio_init(pc, PIN_CMD);
+	gpio_pull_up(PIN_CMD);
+	for (i = 0; i < 4; i++) {
+		pio_gpio_init(pd, PIN_D0 + i);
+		gpio_pull_up(PIN_D0 + i);	/* DAT3 high also keeps the card out of SPI mode at CMD0 */
+	}
+	/* The state machines follow CLK themselves, the synchronisers would only delay it */
+	hw_set_bits(&pc->input_sync_bypass, 0x3Fu << PIN_CLK);
+	hw_set_bits(&pd->input_sync_bypass, 0x3Fu << PIN_CLK);
+
+	pio_set_sm_mask_enabled(pd, (1u << sm_rx) | (1u << sm_tx), false);
+	pio_sm_set_enabled(pc, sm_cmd, false);
+	sdio_cmd_program_init(pc, sm_cmd, off_cmd, PIN_CMD);
+	sdio_data_rx_program_init(pd, sm_rx, off_rx, PIN_D0);
+	sdio_data_tx_program_init(pd, sm_tx, off_tx, PIN_D0);
+	pio_sm_set_enabled(pc, sm_cmd, true);
+	pio_set_sm_mask_enabled(pd, (1u << sm_rx) | (1u << sm_tx), true);
+	sleep_ms(1);			/* 74 clocks before the first command */
+
+	rca = 0;
+	cmd_xfer(CMD0, 0, 0, 0);
+	*v2 = send_cmd(CMD8, 0x1AA, &st) && (st & 0xFFF) == 0x1AA;	/* SDv2 that supports 2.7-3.6V */
+	end = make_timeout_time_ms(1000);
+	do {	/* MMC does not answer CMD55 and is left to the SPI mode code */
+		if (!send_cmd(ACMD41, (*v2 ? 1UL << 30 : 0) | 0x00FF8000, &ocr)) return 0;
+	} while (!(ocr & 1UL << 31) && !time_reached(end));
+	if (!(ocr & 1UL << 31)) return 0;
+	*block = *v2 && (ocr & 1UL << 30);		/* CCS */
+
+	if (!send_cmd_r2(CMD2, 0, csd)) return 0;	/* CID, not kept */
+	if (!send_cmd(CMD3, 0, &st)) return 0;
+	rca = st >> 16;
+	if (!send_cmd_r2(CMD9, (uint32_t)rca << 16, csd)) return 0;
+	if (!send_cmd(CMD7, (uint32_t)rca << 16, &st) || (st & R1_ERRORS) || !wait_busy(100)) return 0;
+	if (!send_cmd(ACMD6, 2, &st) || (st & R1_ERRORS)) return 0;	/* 4-bit bus */
+	if (!send_cmd(CMD16, 512, &st) || (st & R1_ERRORS)) return 0;
+
+	clk_set(SDCARD_SDIO_CLK);
+	if (!read_data(CMD17, 0, 128)) return 0;	/* All four lines and the full clock work */
+	hs = high_speed();
+	return read_data(CMD17, 0, 128);	/* Once more at the clock it settled on */
+}
+
+void sdio_deinit (void)
+{
+	int i;
+
+	if (sm_cmd < 0) return;
+	pio_sm_set_enabled(SDCARD_SDIO_PIO_CMD, sm_cmd, false);
+	pio_set_sm_mask_enabled(SDCARD_SDIO_PIO_DATA, (1u << sm_rx) | (1u << sm_tx), false);
+	pwm_set_enabled(pwm_gpio_to_slice_num(PIN_CLK), false);
+	for (i = 0; i < 6; i++) gpio_init(PIN_CLK + i);
+	gpio_set_inover(PIN_CLK, GPIO_OVERRIDE_NORMAL);
+	clk_hz = 0;
+	hs = false;
+}
+
+int __time_critical_func(sdio_read_block) (
+	uint8_t *buff,
+	uint32_t addr	/* Sector or byte address, by CCS */
+)
+{
+	uint i;
+
+	if (!read_data(CMD17, addr, 128)) return 0;
+	if (!((uintptr_t)buff & 3)) {
+		for (i = 0; i < 128; i++) ((uint32_t *)buff)[i] = __builtin_bswap32(blk[i]);
+	} else {
+		for (i = 0; i < 512; i++) buff[i] = blk[i / 4] >> (24 - 8 * (i & 3));
+	}
+	return 1;
+}
+
+int __time_critical_func(sdio_write_block) (
+	const uint8_t *buff,
+	uint32_t addr
+)
+{
+	PIO pio = SDCARD_SDIO_PIO_DATA;
+	dma_channel_config c = dma_channel_get_default_config(dma_ch);
+	absolute_time_t end;
+	uint64_t crc;
+	uint32_t st, *w = blk + 2;
+	uint i;
+
+	/* The whole stream is laid out first, the FIFO must not run dry with CLK running */
+	blk[0] = TX_NIBBLES - 1;
+	blk[1] = 0xFFFFFFF0;		/* Idle lead-in and the start bit */
+	for (i = 0; i < 128; i++, buff += 4) {
+		w[i] = (uint32_t)buff[0] << 24 | buff[1] << 16 | buff[2] << 8 | buff[3];
+	}
+	crc = crc16_4(w, 128);
+	w[128] = crc >> 32;
+	w[129] = crc;
+
+	if (!send_cmd(CMD24, addr, &st) || (st & R1_ERRORS)) return 0;
+
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+	channel_config_set_read_increment(&c, true);
+	channel_config_set_write_increment(&c, false);
+	channel_config_set_dreq(&c, pio_get_dreq(pio, sm_tx, true));
+	channel_config_set_high_priority(&c, true);
+	dma_channel_configure(dma_ch, &c, &pio->txf[sm_tx], blk, 2 + RX_NIBBLES / 8, true);
+
+	end = make_timeout_time_ms(DATA_TIMEOUT);
+	while (pio_sm_is_rx_fifo_empty(pio, sm_tx)) {	/* CRC status token */
+		if (time_reached(end)) {
+			data_reset();
+			return 0;
+		}
+	}
+	st = pio_sm_get(pio, sm_tx) & 0xF;
+	if (st == 0xB) crc_errors++;	/* The card saw a CRC error */
+	return st == 0x5;
+}
+
+int sdio_busy (void)
+{
+	return !gpio_get(PIN_D0);
+}
+
+uint32_t sdio_clock_hz (void)
+{
+	return clk_hz;
+}
+
+int sdio_high_speed (void)
+{
+	return hs;
+}
+
+uint32_t sdio_crc_errors (void)
+{
+	return crc_errors;
+}
+
+#endif
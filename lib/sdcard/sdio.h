@@ -0,0 +1,35 @@
+#ifndef _SDIO_H_
+#define _SDIO_H_
+
+/* 4-bit SD bus over PIO (SDCARD_SDIO builds), used by sdcard.c ahead of SPI.
+   CLK, CMD and DAT0..DAT3 are consecutive pins from SDCARD_PIN_SDIO_CLK; CLK
+   comes from PWM, the command and data lines from PIO with DMA on the data. */
+
+#include "pico/types.h"
+
+#ifndef SDCARD_SDIO_PIO_CMD
+#define SDCARD_SDIO_PIO_CMD	pio0	/* 18 instructions, fits next to the PIO SPI programs */
+#endif
+#ifndef SDCARD_SDIO_PIO_DATA
+#define SDCARD_SDIO_PIO_DATA	pio1	/* 27 instructions */
+#endif
+#ifndef SDCARD_SDIO_CLK
+#define SDCARD_SDIO_CLK	(25 * MHZ)	/* Default speed limit, met with an even whole divider of clk_sys */
+#endif
+#ifndef SDCARD_SDIO_CLK_HS
+#define SDCARD_SDIO_CLK_HS	(50 * MHZ)	/* High speed limit, after CMD6 */
+#endif
+
+/* Card identification in SD mode up to 4-bit transfers at full clock, checked by reading
+   sector 0, then high speed where the card has it and the clock gains; 1: ready, with the
+   SD version, CCS and the CSD filled in */
+int sdio_init (int *v2, int *block, uint8_t *csd);
+void sdio_deinit (void);	/* Stop the bus and give the pins back */
+int sdio_read_block (uint8_t *buff, uint32_t addr);			/* 1: read, CRC checked */
+int sdio_write_block (const uint8_t *buff, uint32_t addr);	/* 1: accepted, DAT0 low while programming */
+int sdio_busy (void);			/* Card holds DAT0 low */
+uint32_t sdio_clock_hz (void);	/* CLK after sdio_init */
+int sdio_high_speed (void);		/* 1: CMD6 switched the card and the read-back matched */
+uint32_t sdio_crc_errors (void);	/* Data and response CRC mismatches so far */
+
+#endif
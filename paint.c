@@ -1,4 +1,5 @@
 #include "paint.h"
+#include "hot.h"
 #include <stdio.h>
 
 void paint_new_image(PAINT *paint, uint16_t *image, uint8_t width, uint8_t height, uint16_t color) {
@@ -14,7 +15,7 @@ void paint_new_image(PAINT *paint, uint16_t *image, uint8_t width, uint8_t heigh
     paint->heightByte = height ;
 }
 
-void paint_set_pixel(PAINT *paint, uint8_t x, uint8_t y, uint16_t color) {
+void HOT_FUNC(paint_set_pixel)(PAINT *paint, uint8_t x, uint8_t y, uint16_t color) {
     if (x > paint->width || y > paint->height) {
         return;
     }
@@ -22,7 +23,7 @@ void paint_set_pixel(PAINT *paint, uint8_t x, uint8_t y, uint16_t color) {
     paint->image[x + y * paint->width] = ((color << 8) & 0xff00) | (color >> 8) ;
 }
 
-void paint_clear(PAINT *paint, uint16_t color) {
+void HOT_FUNC(paint_clear)(PAINT *paint, uint16_t color) {
     for (uint8_t y = 0; y < paint->height; y++) {
         for (uint8_t x = 0; x < paint->width; x++) {
             paint->image[x + y * paint->width] = ((color << 8) & 0xff00) | (color >> 8) ;
@@ -30,7 +31,7 @@ void paint_clear(PAINT *paint, uint16_t color) {
     }
 }
 
-void paint_draw_char(PAINT *paint, uint8_t x, uint8_t y, const char ch, Font *font, uint16_t bg) {
+void HOT_FUNC(paint_draw_char)(PAINT *paint, uint8_t x, uint8_t y, const char ch, Font *font, uint16_t bg) {
     if (x > paint->width || y > paint->height) {
         return;
     }
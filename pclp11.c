@@ -0,0 +1,333 @@
+#include "pclp11.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/time.h"
+#include "hardware/sync.h"
+#include "storage.h"
+#include "bus.h"
+#include "doorbell.h"
+#include "latency.h"
+
+#define PTR_BUF_SIZE  (2 * STORAGE_CHUNK) // power of 2
+#define OUT_FLUSH_US  10000               // write out a partial chunk once idle
+#define OUT_UNITS     (PC11_UNITS + LP11_UNITS)
+#define DEV_SLOTS     (2 * PC11_UNITS + LP11_UNITS)
+
+PTR_UNIT ptr[PC11_UNITS] ;
+const char * volatile pclp11_error = NULL ;
+
+// reader prefetch
+typedef struct {
+    uint8_t  buf[PTR_BUF_SIZE] ;
+    uint32_t head ;
+    uint32_t tail ;
+    uint32_t gen ;      // bumped on reset, tags the requests
+    bool     opening ;  // open not yet queued
+    bool     open ;
+    bool     reading ;  // read in flight
+    bool     eof ;
+} PTR_FETCH ;
+
+// punch and printer buffers, punches first
+typedef struct {
+    uint8_t  buf[STORAGE_CHUNK] ;
+    uint16_t len ;
+    uint32_t last_us ;
+    uint32_t gen ;
+    bool     opening ;
+    bool     failed ;   // file did not open, report every byte
+} OUT_UNIT ;
+
+static PTR_FETCH fetch[PC11_UNITS] ;
+static OUT_UNIT out[OUT_UNITS] ;
+static volatile bool reload[PC11_UNITS] ;
+
+static PUNCH_REGS *out_regs(uint8_t i) {
+    return i < PC11_UNITS ? &ptp_regs[i] : &lp_regs[i - PC11_UNITS] ;
+}
+
+// unit 0 keeps the historic file name, further units get their number appended
+static void unit_file_name(char *name, const char *base, const char *ext, uint8_t u) {
+    if (u == 0) {
+        sprintf(name, "%s.%s", base, ext) ;
+    } else {
+        sprintf(name, "%s%u.%s", base, u, ext) ;
+    }
+}
+
+static void ptr_open(uint8_t u) {
+    STORAGE_REQ *q = storage_request() ;
+    if (q == NULL) {
+        return ; // retried on the next step
+    }
+
+    q->op = STORAGE_OPEN_READ ;
+    q->file = STORAGE_PTR(u) ;
+    q->tag = fetch[u].gen ;
+    memcpy(q->name, ptr[u].file_name, 11) ;
+    q->name[11] = 0 ;
+    storage_submit() ;
+    fetch[u].opening = false ;
+}
+
+static void ptr_reset(uint8_t u) {
+    PTR_FETCH *f = &fetch[u] ;
+
+    reader_reset(&ptr_regs[u]) ;
+    ptr[u].size = 0 ;
+    ptr[u].pos = 0 ;
+
+    f->gen++ ; // answers still queued for the old tape are dropped
+    f->head = 0 ;
+    f->tail = 0 ;
+    f->open = false ;
+    f->reading = false ;
+    f->eof = false ;
+    f->opening = true ;
+    ptr_open(u) ;
+    doorbell_ring(STORAGE_CORE, DOORBELL_PROGRESS) ;
+}
+
+static void out_open(uint8_t i) {
+    STORAGE_REQ *q = storage_request() ;
+    if (q == NULL) {
+        return ;
+    }
+
+    q->op = STORAGE_OPEN_WRITE ;
+    if (i < PC11_UNITS) {
+        q->file = STORAGE_PTP(i) ;
+        unit_file_name(q->name, "PTP", "TAP", i) ;
+    } else {
+        q->file = STORAGE_LP(i - PC11_UNITS) ;
+        unit_file_name(q->name, "PRT", "TXT", i - PC11_UNITS) ;
+    }
+    q->tag = out[i].gen ;
+    storage_submit() ;
+    out[i].opening = false ;
+}
+
+static void out_reset(uint8_t i) {
+    punch_reset(out_regs(i)) ; // clear interrupt, set ready
+    out[i].gen++ ;
+    out[i].len = 0 ;
+    out[i].failed = false ;
+    out[i].opening = true ;
+    out_open(i) ;
+}
+
+// queue the buffered bytes, false while the queue is full
+static bool out_flush(uint8_t i) {
+    OUT_UNIT *o = &out[i] ;
+    if (o->len == 0) {
+        return true ;
+    }
+
+    STORAGE_REQ *q = o->opening ? NULL : storage_request() ;
+    if (q == NULL) {
+        return false ;
+    }
+
+    q->op = STORAGE_WRITE ;
+    q->file = i < PC11_UNITS ? STORAGE_PTP(i) : STORAGE_LP(i - PC11_UNITS) ;
+    q->len = o->len ;
+    q->tag = o->gen ;
+    memcpy(q->data, o->buf, o->len) ;
+    storage_submit() ;
+    o->len = 0 ;
+    return true ;
+}
+
+static void ptr_done(const STORAGE_DONE *d) {
+    uint8_t u = d->file - STORAGE_PTR(0) ;
+    PTR_FETCH *f = &fetch[u] ;
+    if (d->tag != f->gen) {
+        return ; // tape was reloaded since
+    }
+
+    if (d->op == STORAGE_OPEN_READ) {
+        if (d->res != FR_OK) {
+            pclp11_error = "PTR OPEN ERR" ;
+            doorbell_ring(STORAGE_CORE, DOORBELL_ERROR) ;
+            f->eof = true ;
+        } else {
+            f->open = true ;
+            ptr[u].size = d->size ;
+        }
+        doorbell_ring(STORAGE_CORE, DOORBELL_PROGRESS) ;
+    } else if (d->op == STORAGE_READ) {
+        for (uint16_t n = 0; n < d->len; n++) {
+            f->buf[f->head++ & (PTR_BUF_SIZE - 1)] = d->data[n] ;
+        }
+        f->reading = false ;
+        if (d->res != FR_OK || d->len < STORAGE_CHUNK) {
+            f->eof = true ;
+        }
+    }
+}
+
+static void out_done(const STORAGE_DONE *d) {
+    uint8_t i = d->file - STORAGE_PTP(0) ;
+
+    if (d->res == FR_OK || d->tag != out[i].gen) {
+        return ;
+    }
+
+    if (d->op == STORAGE_OPEN_WRITE) {
+        out[i].failed = true ;
+        if (i < PC11_UNITS) {
+            pclp11_error = "PTP OPEN ERR" ;
+            doorbell_ring(STORAGE_CORE, DOORBELL_ERROR) ;
+        } else {
+            printf("lp11 f_open %d", d->res) ;
+        }
+    } else if (d->op == STORAGE_WRITE) {
+        punch_error(out_regs(i)) ; // bytes were already acknowledged
+    }
+}
+
+static void pclp11_complete() {
+    STORAGE_DONE *d ;
+    while ((d = storage_completion()) != NULL) {
+        if (d->file < STORAGE_PTP(0)) {
+            ptr_done(d) ;
+        } else {
+            out_done(d) ;
+        }
+        storage_release() ;
+    }
+}
+
+// keep a chunk in flight while there is room for it
+static void ptr_fill(uint8_t u) {
+    PTR_FETCH *f = &fetch[u] ;
+    if (f->opening) {
+        ptr_open(u) ;
+        return ;
+    }
+
+    if (!f->open || f->eof || f->reading || PTR_BUF_SIZE - (f->head - f->tail) < STORAGE_CHUNK) {
+        return ;
+    }
+
+    STORAGE_REQ *q = storage_request() ;
+    if (q == NULL) {
+        return ;
+    }
+
+    q->op = STORAGE_READ ;
+    q->file = STORAGE_PTR(u) ;
+    q->len = STORAGE_CHUNK ;
+    q->tag = f->gen ;
+    storage_submit() ;
+    f->reading = true ;
+}
+
+static void ptr_step(uint8_t u) {
+    PTR_FETCH *f = &fetch[u] ;
+
+    ptr_fill(u) ;
+
+    uint32_t seq ;
+    if (!reader_pending(&ptr_regs[u], &seq)) {
+        return ;
+    }
+
+    if (f->head != f->tail) {
+        uint8_t c = f->buf[f->tail++ & (PTR_BUF_SIZE - 1)] ;
+        ptr[u].pos++ ;
+        doorbell_ring(STORAGE_CORE, DOORBELL_PROGRESS) ;
+        reader_complete(&ptr_regs[u], seq, c) ;
+    } else if (f->eof) {
+        reader_complete(&ptr_regs[u], seq, -1) ;
+    }
+    // else stay busy until the prefetch lands
+}
+
+// punch and printer
+static void out_step(uint8_t i) {
+    OUT_UNIT *o = &out[i] ;
+    PUNCH_REGS *regs = out_regs(i) ;
+
+    if (o->opening) {
+        out_open(i) ;
+    }
+
+    uint32_t seq ;
+    uint8_t c ;
+    if (!punch_pending(regs, &seq, &c)) {
+        if (o->len && time_us_32() - o->last_us > OUT_FLUSH_US) {
+            out_flush(i) ;
+        }
+        return ;
+    }
+
+    if (o->failed) {
+        punch_complete(regs, seq, false) ;
+        return ;
+    }
+
+    if (o->len == STORAGE_CHUNK && !out_flush(i)) {
+        return ; // storage is behind, stay not ready
+    }
+
+    o->buf[o->len++] = c ;
+    o->last_us = time_us_32() ;
+    punch_complete(regs, seq, true) ; // set ready
+}
+
+static void dev_step(uint8_t slot) {
+    if (slot < PC11_UNITS) {
+        ptr_step(slot) ;
+    } else {
+        out_step(slot - PC11_UNITS) ;
+    }
+}
+
+void pclp11_init() {
+    for (uint8_t u = 0; u < PC11_UNITS; u++) {
+        unit_file_name(ptr[u].file_name, "PTR", "TAP", u) ;
+    }
+
+    pc11_rst = true ; // opened by the first step
+}
+
+// reader u got a new file_name
+void pclp11_load(uint8_t u) {
+    __dmb() ; // file_name before the flag
+    reload[u] = true ;
+    doorbell_ring(BUS_CORE, DOORBELL_DEVICE) ;
+}
+
+void pclp11_step() {
+    static uint8_t first = 0 ;
+
+    latency_event_done() ;
+    pclp11_complete() ;
+
+    if (pc11_rst) {
+        for (uint8_t i = 0; i < OUT_UNITS; i++) {
+            out_reset(i) ;
+        }
+        for (uint8_t u = 0; u < PC11_UNITS; u++) {
+            reload[u] = false ;
+            ptr_reset(u) ;
+        }
+        pc11_rst = false ;
+        return ;
+    }
+
+    for (uint8_t u = 0; u < PC11_UNITS; u++) {
+        if (reload[u]) {
+            reload[u] = false ;
+            ptr_reset(u) ;
+        }
+    }
+
+    // one byte per device and pass, rotating who is served first
+    for (uint8_t n = 0; n < DEV_SLOTS; n++) {
+        dev_step((first + n) % DEV_SLOTS) ;
+    }
+    first = (first + 1) % DEV_SLOTS ;
+}
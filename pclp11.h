@@ -0,0 +1,25 @@
+#ifndef _PCLP11_H_
+#define _PCLP11_H_
+
+#include "pico/types.h"
+#include "ff.h"
+#include "csr.h"
+
+// Device front end: serves the PC11/LP11 registers from RAM buffers and talks to
+// the card only through the storage queues, so pclp11_step never blocks and can
+// run next to the I2C slave.
+
+typedef struct {
+    char    file_name[11] ; // set by the UI, then pclp11_load
+    FSIZE_t size ;
+    FSIZE_t pos ;
+} PTR_UNIT ;
+
+extern PTR_UNIT ptr[PC11_UNITS] ;
+extern const char * volatile pclp11_error ; // 12 characters max, rings DOORBELL_ERROR
+
+void pclp11_init() ;
+void pclp11_load(uint8_t u) ;
+void pclp11_step() ;
+
+#endif
@@ -0,0 +1,97 @@
+#include "power.h"
+
+#include "pico/time.h"
+#include "hardware/sync.h"
+#include "hardware/structs/clocks.h"
+#include "hardware/structs/scb.h"
+#include "doorbell.h"
+#include "hot.h"
+#include "jobs.h"
+#include "lcd.h"
+#include "storage.h"
+
+static volatile uint32_t last_us ;
+static volatile bool idle = false ;
+static volatile bool wake = false ;
+static volatile alarm_id_t check = 0 ;
+
+static int64_t power_alarm(alarm_id_t id, void *user_data) {
+    check = 0 ;
+    doorbell_ring(STORAGE_CORE, DOORBELL_POWER) ;
+    return 0 ;
+}
+
+static void power_check_in(uint32_t us) {
+    if (check == 0) {
+        check = add_alarm_in_us(us, power_alarm, NULL, true) ;
+    }
+}
+
+void power_init() {
+    // blocks nobody needs while everything sleeps; I2C0, UART0, timer, IO
+    // and the bus fabric keep their clocks
+    clocks_hw->sleep_en0 &= ~(CLOCKS_SLEEP_EN0_CLK_SYS_ADC_BITS | CLOCKS_SLEEP_EN0_CLK_ADC_ADC_BITS |
+        CLOCKS_SLEEP_EN0_CLK_SYS_I2C1_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_JTAG_BITS |
+        CLOCKS_SLEEP_EN0_CLK_SYS_PIO0_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_PIO1_BITS |
+        CLOCKS_SLEEP_EN0_CLK_SYS_PWM_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_RTC_BITS | CLOCKS_SLEEP_EN0_CLK_RTC_RTC_BITS) ;
+    clocks_hw->sleep_en1 &= ~(CLOCKS_SLEEP_EN1_CLK_SYS_SPI0_BITS | CLOCKS_SLEEP_EN1_CLK_PERI_SPI0_BITS |
+        CLOCKS_SLEEP_EN1_CLK_SYS_SPI1_BITS | CLOCKS_SLEEP_EN1_CLK_PERI_SPI1_BITS |
+        CLOCKS_SLEEP_EN1_CLK_SYS_UART1_BITS | CLOCKS_SLEEP_EN1_CLK_PERI_UART1_BITS |
+        CLOCKS_SLEEP_EN1_CLK_SYS_USBCTRL_BITS | CLOCKS_SLEEP_EN1_CLK_USB_USBCTRL_BITS) ;
+
+    last_us = time_us_32() ;
+    power_check_in(POWER_IDLE_MS * 1000) ;
+}
+
+void HOT_FUNC(power_activity)() {
+    last_us = time_us_32() ;
+    if (idle && !wake) {
+        wake = true ;
+        doorbell_ring(STORAGE_CORE, DOORBELL_POWER) ;
+    }
+}
+
+bool HOT_FUNC(power_is_idle)() {
+    return idle ;
+}
+
+void power_sleep_mode() {
+    if (idle) {
+        scb_hw->scr |= M0PLUS_SCR_SLEEPDEEP_BITS ;
+    } else {
+        scb_hw->scr &= ~M0PLUS_SCR_SLEEPDEEP_BITS ;
+    }
+}
+
+void power_task() {
+    if (lcd_busy()) {
+        power_check_in(1000) ; // a strip is still going out
+        return ;
+    }
+
+    if (idle) {
+        if (wake) {
+            lcd_sleep(false) ;
+            idle = false ;
+            wake = false ;
+            doorbell_tick_resume() ; // after idle is clear, or the tick stops itself again
+            __sev() ; // bus core picks up the normal sleep mode
+            power_check_in(POWER_IDLE_MS * 1000) ;
+        }
+        return ;
+    }
+
+    uint32_t quiet = time_us_32() - last_us ;
+    if (quiet < POWER_IDLE_MS * 1000) {
+        power_check_in(POWER_IDLE_MS * 1000 - quiet) ;
+        return ;
+    }
+
+    if (!storage_idle() || job_pending()) {
+        power_check_in(POWER_IDLE_MS * 1000) ;
+        return ;
+    }
+
+    lcd_sleep(true) ;
+    idle = true ;
+}
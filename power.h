@@ -0,0 +1,25 @@
+#ifndef _POWER_H_
+#define _POWER_H_
+
+#include "pico/types.h"
+
+// Idle power state. After POWER_IDLE_MS without host or user activity the LCD
+// and its backlight are switched off and both cores sleep with SLEEPDEEP set,
+// so that the clocks of unused blocks (SPI, PIO, PWM, USB, ADC) stop while
+// both are in WFE. clk_sys keeps running and the I2C block stays clocked: an
+// address match is acknowledged by hardware and its IRQ wakes the bus core
+// with the normal entry latency, so the first transaction is never dropped.
+// The doorbell tick stops and the latency probe slows down while idle, so the
+// cores stay asleep between the probe's samples.
+
+#ifndef POWER_IDLE_MS
+#define POWER_IDLE_MS 60000
+#endif
+
+void power_init() ;     // UI core, after lcd_init
+void power_activity() ; // any core or IRQ
+bool power_is_idle() ;
+void power_task() ;     // UI core, on DOORBELL_POWER
+void power_sleep_mode() ; // each core, right before WFE
+
+#endif
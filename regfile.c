@@ -0,0 +1,139 @@
+#include "regfile.h"
+
+#include "hardware/sync.h"
+#include "hot.h"
+
+// reader
+// DONE is shown while done_rd == rd_seq + 1, so that a zeroed block reads idle.
+
+void reader_reset(READER_REGS *r) {
+    r->ie = 0 ;
+    r->err = 0 ;
+    r->done_rd = r->rd_seq ;
+    __dmb() ;
+    r->done_seq = r->go_seq ;
+}
+
+uint16_t HOT_FUNC(reader_csr)(const READER_REGS *r) {
+    uint32_t done = r->done_seq ;
+    __dmb() ;
+
+    uint16_t v = r->ie ;
+    if (r->go_seq != done) {
+        v |= CSR_BUSY | CSR_GO ;
+    } else if (r->done_rd == r->rd_seq + 1) {
+        v |= CSR_DONE ;
+    }
+
+    if (r->err) {
+        v |= CSR_ERROR ;
+    }
+
+    return v ;
+}
+
+void HOT_FUNC(reader_csr_write)(READER_REGS *r, uint16_t v) {
+    r->ie = v & CSR_IE ;
+    if ((v & CSR_GO) && r->go_seq == r->done_seq) {
+        __dmb() ;
+        r->go_seq++ ; // busy until served, clears done
+    }
+}
+
+uint16_t HOT_FUNC(reader_buf_read)(READER_REGS *r) {
+    uint16_t csr = reader_csr(r) ;
+    if (csr & CSR_BUSY) {
+        return 0123 ; // buffer is cleared by GO
+    }
+
+    uint16_t v = r->buf ;
+    if (csr & CSR_DONE) {
+        r->rd_seq++ ; // clear DONE
+    }
+
+    return v ;
+}
+
+bool reader_pending(const READER_REGS *r, uint32_t *seq) {
+    *seq = r->go_seq ;
+    return *seq != r->done_seq ;
+}
+
+// c < 0 reports a read error
+void reader_complete(READER_REGS *r, uint32_t seq, int c) {
+    if (c < 0) {
+        r->buf = 0123 ;
+        r->err = 1 ;
+    } else {
+        r->buf = c ;
+    }
+
+    r->done_rd = r->rd_seq + 1 ;
+    __dmb() ;
+    r->done_seq = seq ;
+}
+
+// punch, printer
+
+void punch_reset(PUNCH_REGS *p) {
+    p->csr = 0 ;
+    p->err = 0 ;
+    __dmb() ;
+    p->done_seq = p->put_seq ; // clear interrupt, set ready
+}
+
+uint16_t HOT_FUNC(punch_csr)(const PUNCH_REGS *p) {
+    uint32_t done = p->done_seq ;
+    __dmb() ;
+
+    uint16_t v = p->csr ;
+    if (p->put_seq == done) {
+        v |= CSR_DONE ;
+    }
+
+    if (p->err) {
+        v |= CSR_ERROR ;
+    }
+
+    return v ;
+}
+
+void HOT_FUNC(punch_csr_write)(PUNCH_REGS *p, uint16_t v) {
+    p->csr = v ;
+}
+
+uint16_t HOT_FUNC(punch_buf)(const PUNCH_REGS *p) {
+    return p->buf ;
+}
+
+void HOT_FUNC(punch_buf_write)(PUNCH_REGS *p, uint16_t v) {
+    p->buf = v ;
+    __dmb() ;
+    p->put_seq++ ; // clear ready until stored
+}
+
+bool punch_pending(const PUNCH_REGS *p, uint32_t *seq, uint8_t *c) {
+    uint32_t s = p->put_seq ;
+    if (s == p->done_seq) {
+        return false ;
+    }
+
+    __dmb() ;
+    *c = p->buf ;
+    *seq = s ;
+    return true ;
+}
+
+void punch_complete(PUNCH_REGS *p, uint32_t seq, bool ok) {
+    if (!ok) {
+        p->err = 1 ;
+    }
+
+    __dmb() ;
+    p->done_seq = seq ; // set ready
+}
+
+// a buffered write failed after its byte was acknowledged
+void punch_error(PUNCH_REGS *p) {
+    p->err = 1 ;
+}
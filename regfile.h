@@ -0,0 +1,63 @@
+#ifndef _REGFILE_H_
+#define _REGFILE_H_
+
+#include "pico/types.h"
+
+// CSR bits common to PC11 and LP11
+#define CSR_ERROR 0100000
+#define CSR_BUSY    04000
+#define CSR_DONE     0200
+#define CSR_IE       0100
+#define CSR_GO         01
+
+// Registers shared between the I2C IRQ (host side) and pclp11_step (device side).
+//
+// Every word has exactly one writer that may read-modify-write it. Bits that both
+// sides have to flip (GO/BUSY/DONE, READY) are kept as a pair of sequence counters,
+// one per side, and the visible bit is derived from comparing them, so a transition
+// can never be lost to an interleaved update. Data is published before the counter
+// that announces it, separated by __dmb().
+//
+// ie/csr are host bits that the device also clears on reset; both sides only ever
+// store them whole, never read-modify-write them.
+
+typedef struct {
+    // host
+    volatile uint32_t ie ;
+    volatile uint32_t go_seq ;      // bumped by GO while idle
+    volatile uint32_t rd_seq ;      // bumped by a PRB read while DONE
+    // device
+    volatile uint32_t buf ;
+    volatile uint32_t err ;
+    volatile uint32_t done_rd ;     // rd_seq at completion, DONE while unchanged
+    volatile uint32_t done_seq ;    // go_seq served, BUSY while different
+} READER_REGS ;
+
+// PC11 punch and LP11 printer share the layout
+typedef struct {
+    // host
+    volatile uint32_t csr ;         // writable bits, masked by the caller
+    volatile uint32_t buf ;
+    volatile uint32_t put_seq ;     // bumped by a buffer write
+    // device
+    volatile uint32_t err ;
+    volatile uint32_t done_seq ;    // put_seq served, READY while equal
+} PUNCH_REGS ;
+
+void reader_reset(READER_REGS *r) ;
+uint16_t reader_csr(const READER_REGS *r) ;
+void reader_csr_write(READER_REGS *r, uint16_t v) ;
+uint16_t reader_buf_read(READER_REGS *r) ;
+bool reader_pending(const READER_REGS *r, uint32_t *seq) ;
+void reader_complete(READER_REGS *r, uint32_t seq, int c) ;
+
+void punch_reset(PUNCH_REGS *p) ;
+uint16_t punch_csr(const PUNCH_REGS *p) ;
+void punch_csr_write(PUNCH_REGS *p, uint16_t v) ;
+uint16_t punch_buf(const PUNCH_REGS *p) ;
+void punch_buf_write(PUNCH_REGS *p, uint16_t v) ;
+bool punch_pending(const PUNCH_REGS *p, uint32_t *seq, uint8_t *c) ;
+void punch_complete(PUNCH_REGS *p, uint32_t seq, bool ok) ;
+void punch_error(PUNCH_REGS *p) ;
+
+#endif
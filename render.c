@@ -0,0 +1,165 @@
+#include "render.h"
+
+#include <string.h>
+#include "hardware/sync.h"
+#include "lcd.h"
+#include "paint.h"
+#include "doorbell.h"
+
+extern Font font16 ;
+
+enum {
+    RENDER_CLEAR,
+    RENDER_TEXT,
+    RENDER_PROGRESS,
+} ;
+
+typedef struct {
+    uint8_t  op ;
+    uint8_t  ys ;
+    uint16_t fg ;
+    uint16_t bg ;
+    Font    *font ;
+    char     text[13] ;
+    uint32_t size ;
+    uint32_t pos ;
+} RENDER_CMD ;
+
+static uint16_t image[224 * 32] ;
+static PAINT paint ;
+static spin_lock_t *lock ;
+
+static RENDER_CMD queue[RENDER_DEPTH] ;
+static uint32_t head ;
+static uint32_t tail ;
+static uint32_t drops ;
+
+static struct {
+    bool     dirty ;
+    uint32_t size ;
+    uint32_t pos ;
+} progress ;
+
+static void render_done() {
+    doorbell_ring(STORAGE_CORE, DOORBELL_RENDER) ;
+}
+
+void render_init() {
+    lock = spin_lock_init(spin_lock_claim_unused(true)) ;
+    paint_new_image(&paint, image, 224, 32, WHITE) ;
+    lcd_dma_init(render_done) ;
+}
+
+// NULL when the queue is full, then the lock is released already
+static RENDER_CMD *render_put(uint32_t *save) {
+    *save = spin_lock_blocking(lock) ;
+    if (head - tail >= RENDER_DEPTH) {
+        drops++ ;
+        spin_unlock(lock, *save) ;
+        return NULL ;
+    }
+
+    return &queue[head & (RENDER_DEPTH - 1)] ;
+}
+
+static void render_commit(uint32_t save) {
+    head++ ;
+    spin_unlock(lock, save) ;
+    doorbell_ring(STORAGE_CORE, DOORBELL_RENDER) ;
+}
+
+void render_clear(uint16_t color) {
+    uint32_t save ;
+    RENDER_CMD *c = render_put(&save) ;
+    if (c == NULL) {
+        return ;
+    }
+
+    c->op = RENDER_CLEAR ;
+    c->bg = color ;
+    render_commit(save) ;
+}
+
+void render_text(uint8_t ys, const char *text, Font *font, uint16_t fg, uint16_t bg) {
+    uint32_t save ;
+    RENDER_CMD *c = render_put(&save) ;
+    if (c == NULL) {
+        return ;
+    }
+
+    c->op = RENDER_TEXT ;
+    c->ys = ys ;
+    c->fg = fg ;
+    c->bg = bg ;
+    c->font = font ;
+    strncpy(c->text, text, sizeof c->text - 1) ;
+    c->text[sizeof c->text - 1] = 0 ;
+    render_commit(save) ;
+}
+
+void render_progress(uint32_t size, uint32_t pos) {
+    uint32_t save = spin_lock_blocking(lock) ;
+    progress.size = size ;
+    progress.pos = pos ;
+    progress.dirty = true ;
+    spin_unlock(lock, save) ;
+    doorbell_ring(STORAGE_CORE, DOORBELL_RENDER) ;
+}
+
+// takes the next command, the reader position after the queue
+static bool render_get(RENDER_CMD *c) {
+    uint32_t save = spin_lock_blocking(lock) ;
+    bool ok = true ;
+    if (head != tail) {
+        *c = queue[tail & (RENDER_DEPTH - 1)] ;
+        tail++ ;
+    } else if (progress.dirty) {
+        progress.dirty = false ;
+        c->op = RENDER_PROGRESS ;
+        c->size = progress.size ;
+        c->pos = progress.pos ;
+    } else {
+        ok = false ;
+    }
+    spin_unlock(lock, save) ;
+    return ok ;
+}
+
+// UI core, on DOORBELL_RENDER; starts at most one transfer
+void render_task() {
+    RENDER_CMD c ;
+    if (lcd_busy() || !render_get(&c)) {
+        return ;
+    }
+
+    if (c.op == RENDER_CLEAR) {
+        lcd_clear_async(c.bg) ;
+        return ;
+    }
+
+    if (c.op == RENDER_PROGRESS) {
+        c.ys = 168 ;
+        paint_clear(&paint, SCREEN_BG_COLOR) ;
+        paint.color = WHITE ;
+        paint_draw_string(&paint, 10, 6, "pos", &font16, SCREEN_BG_COLOR) ;
+        paint_draw_number(&paint, 8, 10, c.size, &font16, SCREEN_BG_COLOR) ;
+        paint_draw_number(&paint, 150, 10, c.pos, &font16, SCREEN_BG_COLOR) ;
+    } else {
+        paint_clear(&paint, c.bg) ;
+        paint.color = c.fg ;
+        paint_draw_string(&paint, 10, 6, c.text, c.font, c.bg) ;
+    }
+    lcd_display_window_async(8, c.ys, 232, c.ys + 32, image) ;
+}
+
+void render_sync() {
+    while (true) {
+        render_task() ;
+        uint32_t save = spin_lock_blocking(lock) ;
+        bool idle = head == tail && !progress.dirty ;
+        spin_unlock(lock, save) ;
+        if (idle && !lcd_busy()) {
+            return ;
+        }
+    }
+}
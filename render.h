@@ -0,0 +1,23 @@
+#ifndef _RENDER_H_
+#define _RENDER_H_
+
+#include "pico/types.h"
+#include "font.h"
+
+// Display commands are queued from either core and drawn by render_task on the
+// UI core, one 224x32 strip at a time. The strip goes to the LCD by DMA, the
+// next command is taken when DOORBELL_RENDER reports the transfer done, so
+// nobody waits for SPI1 and the paint buffer is never shared.
+
+#define RENDER_DEPTH 16 // power of 2
+
+#define SCREEN_BG_COLOR 0x1E0
+
+void render_init() ;
+void render_clear(uint16_t color) ;
+void render_text(uint8_t ys, const char *text, Font *font, uint16_t fg, uint16_t bg) ; // 12 characters max
+void render_progress(uint32_t size, uint32_t pos) ; // latest values win
+void render_task() ;
+void render_sync() ; // draw everything queued, blocking
+
+#endif
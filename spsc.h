@@ -0,0 +1,47 @@
+#ifndef _SPSC_H_
+#define _SPSC_H_
+
+#include "pico/types.h"
+#include "hardware/sync.h"
+
+// Single-producer/single-consumer ring indices for a slot array owned by the
+// caller (size a power of 2). head is written by the producer only, tail by the
+// consumer only; slot contents are published and released with __dmb().
+typedef struct {
+    volatile uint32_t head ;
+    volatile uint32_t tail ;
+} SPSC ;
+
+// producer: index of the slot to fill, -1 when full
+static inline int spsc_put_slot(const SPSC *q, uint32_t size) {
+    uint32_t h = q->head ;
+    if (h - q->tail >= size) {
+        return -1 ;
+    }
+
+    __dmb() ; // consumer is done with the slot
+    return h & (size - 1) ;
+}
+
+static inline void spsc_put_commit(SPSC *q) {
+    __dmb() ;
+    q->head = q->head + 1 ;
+}
+
+// consumer: index of the oldest slot, -1 when empty
+static inline int spsc_get_slot(const SPSC *q, uint32_t size) {
+    uint32_t t = q->tail ;
+    if (q->head == t) {
+        return -1 ;
+    }
+
+    __dmb() ; // producer has filled the slot
+    return t & (size - 1) ;
+}
+
+static inline void spsc_get_commit(SPSC *q) {
+    __dmb() ;
+    q->tail = q->tail + 1 ;
+}
+
+#endif
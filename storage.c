@@ -0,0 +1,124 @@
+#include "storage.h"
+
+#include "pico/time.h"
+#include "sdcard.h"
+#include "spsc.h"
+#include "bus.h"
+#include "doorbell.h"
+
+static FIL files[STORAGE_FILES] ;
+
+static STORAGE_REQ reqs[STORAGE_DEPTH] ;
+static STORAGE_DONE dones[STORAGE_DEPTH] ;
+static SPSC req_q ;
+static SPSC done_q ;
+static volatile alarm_id_t stream_check = 0 ;
+
+STORAGE_REQ *storage_request() {
+    int n = spsc_put_slot(&req_q, STORAGE_DEPTH) ;
+    return n < 0 ? NULL : &reqs[n] ;
+}
+
+void storage_submit() {
+    spsc_put_commit(&req_q) ;
+    doorbell_ring(STORAGE_CORE, DOORBELL_STORAGE) ;
+}
+
+// no request waiting
+bool storage_idle() {
+    return spsc_get_slot(&req_q, STORAGE_DEPTH) < 0 ;
+}
+
+STORAGE_DONE *storage_completion() {
+    int n = spsc_get_slot(&done_q, STORAGE_DEPTH) ;
+    return n < 0 ? NULL : &dones[n] ;
+}
+
+void storage_release() {
+    spsc_get_commit(&done_q) ;
+    doorbell_ring(STORAGE_CORE, DOORBELL_STORAGE) ; // storage_task may be waiting for the slot
+}
+
+static FRESULT storage_exec(const STORAGE_REQ *q, STORAGE_DONE *d) {
+    FIL *f = &files[q->file] ;
+    FRESULT fr ;
+    UINT n = 0 ;
+
+    switch (q->op) {
+        case STORAGE_OPEN_READ:
+            f_close(f) ;
+            fr = f_open(f, q->name, FA_READ | FA_OPEN_ALWAYS) ;
+            if (fr != FR_OK && fr != FR_EXIST) {
+                return fr ;
+            }
+            d->size = f_size(f) ;
+            return FR_OK ;
+
+        case STORAGE_OPEN_WRITE:
+            f_close(f) ;
+            fr = f_open(f, q->name, FA_WRITE | FA_CREATE_ALWAYS) ;
+            if (fr != FR_OK && fr != FR_EXIST) {
+                return fr ;
+            }
+            f_truncate(f) ;
+            f_lseek(f, 0) ;
+            return FR_OK ;
+
+        case STORAGE_READ:
+            fr = f_read(f, d->data, q->len, &n) ;
+            d->len = n ;
+            return fr ;
+
+        case STORAGE_WRITE:
+            fr = f_write(f, q->data, q->len, &n) ;
+            d->len = n ;
+            if (fr == FR_OK && n != q->len) {
+                return FR_DENIED ; // volume full
+            }
+            return fr == FR_OK ? f_sync(f) : fr ;
+
+        case STORAGE_CLOSE:
+            return f_close(f) ;
+
+        default:
+            return FR_INVALID_PARAMETER ;
+    }
+}
+
+// serve requests in order while there is room for the answers
+void storage_task() {
+    int r, c ;
+    bool done = false ;
+    while ((r = spsc_get_slot(&req_q, STORAGE_DEPTH)) >= 0 && (c = spsc_put_slot(&done_q, STORAGE_DEPTH)) >= 0) {
+        const STORAGE_REQ *q = &reqs[r] ;
+        STORAGE_DONE *d = &dones[c] ;
+
+        d->op = q->op ;
+        d->file = q->file ;
+        d->tag = q->tag ;
+        d->len = 0 ;
+        d->size = 0 ;
+
+        d->res = storage_exec(q, d) ;
+
+        spsc_get_commit(&req_q) ;
+        spsc_put_commit(&done_q) ;
+        done = true ;
+    }
+
+    if (done) {
+        doorbell_ring(BUS_CORE, DOORBELL_DEVICE) ;
+    }
+}
+
+static int64_t stream_alarm(alarm_id_t id, void *user_data) {
+    stream_check = 0 ;
+    doorbell_ring(STORAGE_CORE, DOORBELL_STORAGE) ;
+    return 0 ;
+}
+
+void storage_poll() {
+    if (sdcard_stream_poll() && stream_check == 0) {
+        stream_check = add_alarm_in_ms(SDCARD_STREAM_IDLE_MS, stream_alarm, NULL, true) ;
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef _STORAGE_H_
+#define _STORAGE_H_
+
+#include "pico/types.h"
+#include "ff.h"
+#include "csr.h"
+
+// Storage engine: all FatFs file I/O of the emulated devices runs in
+// storage_task on core 0, fed through a request queue and answered through a
+// completion queue, both SPSC. Either side rings the other's doorbell when it
+// queues something, so both can sleep in between.
+
+#define STORAGE_CHUNK 128
+#define STORAGE_DEPTH 8 // power of 2
+
+// file slots: readers, punches, printers
+#define STORAGE_PTR(u) (u)
+#define STORAGE_PTP(u) (PC11_UNITS + (u))
+#define STORAGE_LP(u)  (2 * PC11_UNITS + (u))
+#define STORAGE_FILES  (2 * PC11_UNITS + LP11_UNITS)
+
+enum {
+    STORAGE_OPEN_READ,  // name -> size
+    STORAGE_OPEN_WRITE, // name, truncated
+    STORAGE_READ,       // len -> data, short at end of file
+    STORAGE_WRITE,      // data, synced
+    STORAGE_CLOSE,
+} ;
+
+typedef struct {
+    uint8_t  op ;
+    uint8_t  file ;
+    uint16_t len ;
+    uint32_t tag ;  // returned as is, lets the requester drop stale answers
+    char     name[12] ;
+    uint8_t  data[STORAGE_CHUNK] ;
+} STORAGE_REQ ;
+
+typedef struct {
+    uint8_t  op ;
+    uint8_t  file ;
+    uint8_t  res ;  // FRESULT
+    uint16_t len ;
+    uint32_t tag ;
+    FSIZE_t  size ;
+    uint8_t  data[STORAGE_CHUNK] ;
+} STORAGE_DONE ;
+
+// front end
+STORAGE_REQ *storage_request() ;    // slot to fill, NULL when the queue is full
+void storage_submit() ;
+STORAGE_DONE *storage_completion() ; // oldest answer, NULL when none
+void storage_release() ;
+
+// storage core
+void storage_task() ;
+bool storage_idle() ;
+void storage_poll() ; // after any FatFs use, closes the card's read stream once quiet
+
+#endif
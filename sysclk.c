@@ -0,0 +1,29 @@
+#include "sysclk.h"
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/vreg.h"
+#include "bus.h"
+#include "lcd.h"
+#include "sdcard.h"
+
+static bool profile_ok = false ;
+
+void sysclk_init() {
+#if SYSCLK_MHZ > 200
+    vreg_set_voltage(VREG_VOLTAGE_1_15) ; // 250 MHz is not reliable at 1.10 V
+    sleep_ms(1) ;
+#endif
+
+    // also moves clk_peri to the new clk_sys; stays at 125 MHz if the PLL
+    // cannot make the profile
+    profile_ok = set_sys_clock_khz(SYSCLK_MHZ * KHZ, false) ;
+}
+
+void sysclk_report() {
+    printf("clock profile %u MHz%s\n", SYSCLK_MHZ, profile_ok ? "" : " not available") ;
+    printf("clk_sys %u kHz clk_peri %u kHz\n", clock_get_hz(clk_sys) / KHZ, clock_get_hz(clk_peri) / KHZ) ;
+    printf("sd %s %u kHz lcd spi %u kHz i2c %u kHz backlight pwm %u Hz\n",
+        sdcard_mode(), sdcard_clock_hz() / KHZ, lcd_spi_hz() / KHZ, bus_baud_hz() / KHZ, lcd_bl_pwm_hz()) ;
+}
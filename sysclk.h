@@ -0,0 +1,21 @@
+#ifndef _SYSCLK_H_
+#define _SYSCLK_H_
+
+#include "pico/types.h"
+
+// System clock profile, picked at build time: 125 (default), 200 or 250 MHz.
+// clk_peri follows clk_sys, and every peripheral computes its divider from
+// clock_get_hz() against its own rate limit at init, so the SD, LCD, I2C and
+// backlight rates stay within their limits under any profile.
+#ifndef SYSCLK_MHZ
+#define SYSCLK_MHZ 125
+#endif
+
+#if SYSCLK_MHZ != 125 && SYSCLK_MHZ != 200 && SYSCLK_MHZ != 250
+#error SYSCLK_MHZ must be 125, 200 or 250
+#endif
+
+void sysclk_init() ;   // first thing in main, before stdio and any peripheral
+void sysclk_report() ; // effective rates, after all peripherals are up
+
+#endif
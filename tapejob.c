@@ -0,0 +1,113 @@
+#include "tapejob.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "ff.h"
+#include "jobs.h"
+
+#define SUM_CHUNK 512 // one sector per step
+
+static struct {
+    int      id ;
+    DIR      dir ;
+    FILINFO  fio ;
+    uint32_t files ;
+    FSIZE_t  bytes ;
+} idx = { -1 } ;
+
+static struct {
+    int      id ;
+    FIL      file ;
+    char     name[12] ;
+    FSIZE_t  size ;
+    uint16_t s1 ;
+    uint16_t s2 ;
+    FRESULT  fr ;
+    uint8_t  buf[SUM_CHUNK] ;
+} sum = { -1 } ;
+
+static bool index_step(void *ctx) {
+    if (idx.fio.fname[0] == 0) {
+        return false ;
+    }
+
+    idx.files++ ;
+    idx.bytes += idx.fio.fsize ;
+    return f_findnext(&idx.dir, &idx.fio) == FR_OK ;
+}
+
+static void index_end(void *ctx, bool cancelled) {
+    f_closedir(&idx.dir) ;
+    if (!cancelled) {
+        printf("%u tapes, %u bytes\n", idx.files, (uint32_t)idx.bytes) ;
+    }
+    idx.id = -1 ;
+}
+
+void tapejob_index() {
+    if (idx.id >= 0) {
+        return ; // already running
+    }
+
+    idx.files = 0 ;
+    idx.bytes = 0 ;
+    if (f_findfirst(&idx.dir, &idx.fio, "", "*.TAP") != FR_OK) {
+        printf("index: no directory\n") ;
+        return ;
+    }
+
+    idx.id = job_submit("index", JOB_NORMAL, index_step, index_end, NULL) ;
+    if (idx.id < 0) {
+        f_closedir(&idx.dir) ;
+        printf("index: no job slot\n") ;
+    }
+}
+
+static bool checksum_step(void *ctx) {
+    UINT n = 0 ;
+    sum.fr = f_read(&sum.file, sum.buf, SUM_CHUNK, &n) ;
+    if (sum.fr != FR_OK) {
+        return false ;
+    }
+
+    for (UINT i = 0; i < n; i++) {
+        sum.s1 = (sum.s1 + sum.buf[i]) % 255 ;
+        sum.s2 = (sum.s2 + sum.s1) % 255 ;
+    }
+    sum.size += n ;
+    return n == SUM_CHUNK ;
+}
+
+static void checksum_end(void *ctx, bool cancelled) {
+    f_close(&sum.file) ;
+    if (sum.fr != FR_OK) {
+        printf("%s: read error %d at %u\n", sum.name, sum.fr, (uint32_t)sum.size) ;
+    } else if (!cancelled) {
+        printf("%s: %u bytes fletcher16 %06o\n", sum.name, (uint32_t)sum.size, (sum.s2 << 8) | sum.s1) ;
+    }
+    sum.id = -1 ;
+}
+
+void tapejob_checksum(const char *name) {
+    if (sum.id >= 0) {
+        printf("checksum: busy with %s\n", sum.name) ;
+        return ;
+    }
+
+    memset(sum.name, 0, sizeof sum.name) ;
+    strncpy(sum.name, name, sizeof sum.name - 1) ;
+    sum.size = 0 ;
+    sum.s1 = 0 ;
+    sum.s2 = 0 ;
+    sum.fr = f_open(&sum.file, sum.name, FA_READ) ;
+    if (sum.fr != FR_OK) {
+        printf("%s: open error %d\n", sum.name, sum.fr) ;
+        return ;
+    }
+
+    sum.id = job_submit("checksum", JOB_LOW, checksum_step, checksum_end, NULL) ;
+    if (sum.id < 0) {
+        f_close(&sum.file) ;
+        printf("checksum: no job slot\n") ;
+    }
+}
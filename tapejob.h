@@ -0,0 +1,8 @@
+#ifndef _TAPEJOB_H_
+#define _TAPEJOB_H_
+
+// Background jobs over the tape files, results go to stdio.
+void tapejob_index() ;                   // count *.TAP files and their size
+void tapejob_checksum(const char *name) ; // read a tape end to end, Fletcher-16
+
+#endif
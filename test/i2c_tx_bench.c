@@ -0,0 +1,225 @@
+// Host model of the I2C slave response path: bus.c and csr.c built unchanged
+// against a model of the I2C block and a DMA channel, driven through the slave
+// handler the way the IRQ would. For each response it reports the host CPU
+// time of the handler, per response and per byte, the CPU stores into the I2C
+// and DMA blocks, and the bus time of the bytes at 400 kHz and 1 MHz. The last
+// columns model what feeding the same response by FIFO writes from the IRQ
+// would cost: the handler would have to stay until all but the 16 FIFO entries
+// were taken off the bus.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "pico/i2c_slave.h"
+#include "bus.h"
+#include "csr.h"
+
+#define FIFO_DEPTH 16
+#define BYTE_BITS 9 // 8 data bits and the master's ACK
+
+// model
+
+static i2c_hw_t i2c0_hw ;
+i2c_inst_t i2c0_inst = { &i2c0_hw } ;
+
+static i2c_slave_handler_t handler ;
+static bool dma_free = true ;
+
+static struct {
+    uint8_t rx[8] ;
+    uint8_t rx_len ;
+    uint8_t rx_pos ;
+    uint32_t fifo_bytes ;
+    uint32_t dma_bytes ;
+    uint32_t stores ;
+} bus ;
+
+void gpio_init(uint gpio) {
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+}
+
+void gpio_pull_up(uint gpio) {
+}
+
+bool gpio_get(uint gpio) {
+    return true ;
+}
+
+void gpio_put(uint gpio, bool value) {
+}
+
+uint32_t time_us_32(void) {
+    return 0 ; // the frame is always complete, no timeout can expire
+}
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) {
+    return baudrate ;
+}
+
+void i2c_deinit(i2c_inst_t *i2c) {
+}
+
+size_t i2c_get_read_available(i2c_inst_t *i2c) {
+    return bus.rx_len - bus.rx_pos ;
+}
+
+uint8_t i2c_read_byte_raw(i2c_inst_t *i2c) {
+    return bus.rx[bus.rx_pos++] ;
+}
+
+void i2c_write_byte_raw(i2c_inst_t *i2c, uint8_t value) {
+    i2c->hw->data_cmd = value ;
+    bus.fifo_bytes++ ;
+    bus.stores++ ;
+}
+
+uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx) {
+    return 32 ;
+}
+
+void i2c_slave_init(i2c_inst_t *i2c, uint8_t address, i2c_slave_handler_t h) {
+    handler = h ;
+}
+
+void i2c_slave_deinit(i2c_inst_t *i2c) {
+    handler = NULL ;
+}
+
+int dma_claim_unused_channel(bool required) {
+    return dma_free ? 0 : -1 ;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    dma_channel_config c = { 0 } ;
+    return c ;
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) {
+}
+
+void channel_config_set_read_increment(dma_channel_config *c, bool incr) {
+}
+
+void channel_config_set_write_increment(dma_channel_config *c, bool incr) {
+}
+
+void channel_config_set_dreq(dma_channel_config *c, uint dreq) {
+}
+
+// read, write, count and control with trigger, paced by the DREQ from there on
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+    const volatile void *read_addr, uint transfer_count, bool trigger) {
+    bus.dma_bytes += transfer_count ;
+    bus.stores += 4 ;
+}
+
+bool dma_channel_is_busy(uint channel) {
+    return false ;
+}
+
+void dma_channel_abort(uint channel) {
+}
+
+// the rest of the firmware the slave calls into
+
+void doorbell_ring(uint core, uint32_t bits) {
+}
+
+void latency_event_mark() {
+}
+
+void power_activity() {
+}
+
+void trace_record(uint8_t addr, uint8_t dir, uint16_t value, uint16_t csr) {
+}
+
+// benchmark
+
+static uint8_t crc8(const uint8_t *b, uint8_t len) {
+    uint8_t crc = 0 ;
+    while (len--) {
+        crc ^= *b++ ;
+        for (int i = 0; i < 8; i++) {
+            crc = crc & 0200 ? (crc << 1) ^ 007 : crc << 1 ;
+        }
+    }
+    return crc ;
+}
+
+static uint64_t now_ns() {
+    struct timespec t ;
+    clock_gettime(CLOCK_MONOTONIC, &t) ;
+    return (uint64_t)t.tv_sec * 1000000000u + t.tv_nsec ;
+}
+
+// one read transaction: address (and seq, crc when framed), then the response
+static void transfer(uint8_t addr, bool framed, uint8_t seq) {
+    bus.rx_len = 0 ;
+    bus.rx_pos = 0 ;
+    bus.rx[bus.rx_len++] = addr | (framed ? BUS_FRAMED : 0) ;
+    if (framed) {
+        bus.rx[bus.rx_len++] = seq ;
+        bus.rx[bus.rx_len] = crc8(bus.rx, bus.rx_len) ;
+        bus.rx_len++ ;
+    }
+
+    handler(i2c0, I2C_SLAVE_RECEIVE) ;
+    handler(i2c0, I2C_SLAVE_REQUEST) ;
+    handler(i2c0, I2C_SLAVE_FINISH) ;
+}
+
+static void run(const char *name, uint8_t addr, bool framed, bool dma, uint32_t rounds) {
+    dma_free = dma ;
+    bus_init() ;
+
+    transfer(addr, framed, 0) ; // warm up, and count the bytes of one response
+    bus.fifo_bytes = 0 ;
+    bus.dma_bytes = 0 ;
+    bus.stores = 0 ;
+
+    uint64_t t = now_ns() ;
+    for (uint32_t i = 0; i < rounds; i++) {
+        transfer(addr, framed, i + 1) ; // a new seq each time, never a replay
+    }
+    t = now_ns() - t ;
+
+    double bytes = (double)(bus.fifo_bytes + bus.dma_bytes) / rounds ;
+    double ns = (double)t / rounds ;
+    printf("%-16s %-4s %6.1f %9.1f %8.2f %7.1f", name, dma ? "dma" : "fifo", bytes, ns, ns / bytes,
+        (double)bus.stores / rounds) ;
+
+    static const uint32_t hz[] = { 400000, 1000000 } ;
+    for (int n = 0; n < 2; n++) {
+        double byte_us = BYTE_BITS * 1e6 / hz[n] ;
+        double wait_us = bytes > FIFO_DEPTH ? (bytes - FIFO_DEPTH) * byte_us : 0 ;
+        printf(" %8.1f %9.2f", bytes * byte_us, (ns / 1000 + wait_us) / bytes) ;
+    }
+    printf("\n") ;
+}
+
+int main(int argc, char **argv) {
+    uint32_t rounds = argc > 1 ? strtoul(argv[1], NULL, 0) : 200000 ;
+
+    for (int u = 0; u < PC11_UNITS; u++) {
+        reader_reset(&ptr_regs[u]) ;
+        punch_reset(&ptp_regs[u]) ;
+    }
+    for (int u = 0; u < LP11_UNITS; u++) {
+        punch_reset(&lp_regs[u]) ;
+    }
+
+    printf("%u responses each, host CPU time; wire and FIFO-fed us at 400 kHz, then 1 MHz\n", rounds) ;
+    printf("%-16s %-4s %6s %9s %8s %7s %8s %9s %8s %9s\n", "response", "path", "bytes", "ns", "ns/byte",
+        "stores", "wire us", "fifo us/B", "wire us", "fifo us/B") ;
+    run("PRS read", PC11_BASE0 + PC11_PRS, false, true, rounds) ;
+    run("PRS read framed", PC11_BASE0 + PC11_PRS, true, true, rounds) ;
+    run("snapshot", CSR_SNAPSHOT, false, true, rounds) ;
+    run("snapshot framed", CSR_SNAPSHOT, true, true, rounds) ;
+    run("snapshot framed", CSR_SNAPSHOT, true, false, rounds) ; // refused, BUS_ACK_ERR
+    return 0 ;
+}
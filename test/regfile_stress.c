@@ -0,0 +1,135 @@
+// Host stress test for regfile.c: one thread plays the I2C IRQ (host side),
+// the other pclp11_step (device side), both hammering the same registers.
+// Every GO must be served exactly once and show DONE with its own byte, every
+// punch byte must reach the device once and in order, and READY must never
+// show while a byte is still unserved.
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "hardware/sync.h"
+#include "regfile.h"
+
+#define CHECK(c, ...) do { \
+    if (!(c)) { \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__) ; \
+        printf(__VA_ARGS__) ; \
+        printf("\n") ; \
+        exit(1) ; \
+    } \
+} while (0)
+
+static const uint32_t SPIN_MAX = 100000000 ; // a lost edge would spin forever
+
+static READER_REGS reader ;
+static PUNCH_REGS punch ;
+static uint32_t rounds = 1000000 ;
+static volatile bool host_done = false ;
+static volatile uint32_t punched = 0 ; // bytes the device has taken
+
+static void spin(uint32_t *n, const char *what) {
+    CHECK(++*n < SPIN_MAX, "stuck waiting for %s", what) ;
+    if ((*n & 077) == 0) {
+        sched_yield() ;
+    }
+}
+
+static void *device(void *arg) {
+    uint32_t served = 0 ;
+    uint32_t taken = 0 ;
+    uint32_t idle = 0 ;
+
+    while (!host_done) {
+        bool work = false ;
+        uint32_t seq ;
+        if (reader_pending(&reader, &seq)) {
+            reader_complete(&reader, seq, served++ & 0377) ;
+            work = true ;
+        }
+
+        uint8_t c ;
+        if (punch_pending(&punch, &seq, &c)) {
+            CHECK(c == (taken & 0377), "punch byte %u, expected %u", c, taken & 0377) ;
+            taken++ ;
+            punched = taken ;
+            __dmb() ;
+            punch_complete(&punch, seq, true) ;
+            work = true ;
+        }
+
+        // let the host run on a single CPU, but mostly race it
+        if (!work && (++idle & 077) == 0) {
+            sched_yield() ;
+        }
+    }
+
+    return NULL ;
+}
+
+// GO, then poll PRS like the host would, with IE writes while busy that must
+// neither start nor end a read
+static void host_reader(uint32_t i) {
+    uint32_t n = 0 ;
+
+    reader_csr_write(&reader, CSR_GO | (i & 1 ? CSR_IE : 0)) ;
+    uint16_t csr ;
+    while ((csr = reader_csr(&reader)) & CSR_BUSY) {
+        CHECK(!(csr & CSR_DONE), "BUSY and DONE together, round %u", i) ;
+        if (n & 1) {
+            reader_csr_write(&reader, n & 2 ? CSR_IE : 0) ;
+        }
+        spin(&n, "reader DONE") ;
+    }
+
+    CHECK(csr & CSR_DONE, "GO served without DONE, round %u csr %06o", i, csr) ;
+    CHECK(!(csr & CSR_ERROR), "ERROR without a read error, round %u", i) ;
+
+    uint16_t c = reader_buf_read(&reader) ;
+    CHECK(c == (i & 0377), "reader byte %u, expected %u", c, i & 0377) ;
+    CHECK(!(reader_csr(&reader) & CSR_DONE), "DONE survived the PRB read, round %u", i) ;
+}
+
+// wait for READY, which must mean the device has the previous byte
+static void host_punch(uint32_t i) {
+    uint32_t n = 0 ;
+
+    while (!(punch_csr(&punch) & CSR_DONE)) {
+        spin(&n, "punch READY") ;
+    }
+    __dmb() ;
+    CHECK(punched == i, "READY with %u of %u bytes served", punched, i) ;
+
+    punch_csr_write(&punch, i & 1 ? CSR_IE : 0) ;
+    punch_buf_write(&punch, i & 0377) ;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        rounds = strtoul(argv[1], NULL, 0) ;
+    }
+
+    reader_reset(&reader) ;
+    punch_reset(&punch) ;
+
+    pthread_t t ;
+    CHECK(pthread_create(&t, NULL, device, NULL) == 0, "pthread_create") ;
+
+    for (uint32_t i = 0; i < rounds; i++) {
+        host_reader(i) ;
+        host_punch(i) ;
+    }
+
+    uint32_t n = 0 ;
+    while (!(punch_csr(&punch) & CSR_DONE)) {
+        spin(&n, "last punch READY") ;
+    }
+
+    host_done = true ;
+    pthread_join(t, NULL) ;
+
+    CHECK(reader.go_seq == rounds, "%u GOs accepted for %u rounds", reader.go_seq, rounds) ;
+    CHECK(punched == rounds, "%u of %u punch bytes served", punched, rounds) ;
+    printf("regfile: %u reader and %u punch transitions, none lost\n", rounds, rounds) ;
+    return 0 ;
+}
@@ -0,0 +1,33 @@
+#ifndef _HARDWARE_I2C_H
+#define _HARDWARE_I2C_H
+
+// Host build: the I2C block as the slave code sees it, implemented by the model
+#include "pico/types.h"
+
+typedef struct {
+    volatile uint32_t data_cmd ;
+    volatile uint32_t dma_cr ;
+    volatile uint32_t dma_tdlr ;
+} i2c_hw_t ;
+
+typedef struct i2c_inst {
+    i2c_hw_t *hw ;
+} i2c_inst_t ;
+
+extern i2c_inst_t i2c0_inst ;
+#define i2c0 (&i2c0_inst)
+
+#define I2C_IC_DMA_CR_TDMAE_BITS 0x2u
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) ;
+void i2c_deinit(i2c_inst_t *i2c) ;
+size_t i2c_get_read_available(i2c_inst_t *i2c) ;
+uint8_t i2c_read_byte_raw(i2c_inst_t *i2c) ;
+void i2c_write_byte_raw(i2c_inst_t *i2c, uint8_t value) ;
+uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx) ;
+
+static inline i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c) {
+    return i2c->hw ;
+}
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef _HARDWARE_SYNC_H
+#define _HARDWARE_SYNC_H
+
+#include "pico/types.h"
+
+// Host build: the DMB that orders data before its sequence counter becomes a
+// full fence, so the host CPU keeps the same publication order as the M0+.
+static inline void __dmb(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST) ;
+}
+
+// single threaded callers only, nothing to mask
+static inline uint32_t save_and_disable_interrupts(void) {
+    return 0 ;
+}
+
+static inline void restore_interrupts(uint32_t status) {
+    (void) status ;
+}
+
+#endif
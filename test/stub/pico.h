@@ -0,0 +1,10 @@
+#ifndef _PICO_H
+#define _PICO_H
+
+// Host build: no SRAM sections, see hot.h
+#include "pico/types.h"
+
+#define __not_in_flash(group)
+#define __not_in_flash_func(f) f
+
+#endif
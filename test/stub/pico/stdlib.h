@@ -0,0 +1,25 @@
+#ifndef _PICO_STDLIB_H
+#define _PICO_STDLIB_H
+
+// Host build: the GPIO and timer calls of the I2C slave, implemented by the
+// model that links it (i2c_tx_bench.c)
+#include "pico.h"
+
+#define PICO_DEFAULT_LED_PIN 25
+#define PICO_DEFAULT_I2C_SDA_PIN 4
+#define PICO_DEFAULT_I2C_SCL_PIN 5
+
+enum gpio_function { GPIO_FUNC_I2C = 3 } ;
+
+void gpio_init(uint gpio) ;
+void gpio_set_function(uint gpio, enum gpio_function fn) ;
+void gpio_pull_up(uint gpio) ;
+bool gpio_get(uint gpio) ;
+void gpio_put(uint gpio, bool value) ;
+
+uint32_t time_us_32(void) ;
+
+static inline void tight_loop_contents(void) {
+}
+
+#endif
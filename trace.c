@@ -0,0 +1,58 @@
+#include "trace.h"
+
+#include <stdio.h>
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "hot.h"
+
+#define TRACE_MASK (TRACE_ENTRIES - 1)
+#define TRACE_LINES_PER_STEP 4
+
+static TRACE_ENTRY ring[TRACE_ENTRIES] ;
+static volatile uint32_t head = 0 ;  // next slot to write, producer only
+static uint32_t tail = 0 ;           // next slot to print, consumer only
+static uint32_t dump_end = 0 ;
+
+void HOT_FUNC(trace_record)(uint8_t addr, uint8_t dir, uint16_t value, uint16_t csr) {
+    uint32_t h = head ;
+    TRACE_ENTRY *e = &ring[h & TRACE_MASK] ;
+    e->us = time_us_32() ;
+    e->addr = addr ;
+    e->dir = dir ;
+    e->value = value ;
+    e->csr = csr ;
+    __dmb() ;
+    head = h + 1 ;
+}
+
+void trace_dump_start() {
+    uint32_t h = head ;
+    dump_end = h ;
+    tail = h >= TRACE_ENTRIES ? h - TRACE_ENTRIES + 1 : 0 ;
+    printf("trace %u..%u\n", tail, dump_end) ;
+}
+
+bool trace_dump_step() {
+    // the slot at head - TRACE_ENTRIES may be half written, keep clear of it
+    for (uint8_t n = 0; n < TRACE_LINES_PER_STEP && (int32_t)(dump_end - tail) > 0; n++) {
+        uint32_t h = head ;
+        if (h - tail >= TRACE_ENTRIES) {
+            printf("trace lost %u\n", h - TRACE_ENTRIES + 1 - tail) ; // overwritten while dumping
+            tail = h - TRACE_ENTRIES + 1 ;
+            continue ;
+        }
+
+        __dmb() ;
+        TRACE_ENTRY e = ring[tail & TRACE_MASK] ;
+        __dmb() ;
+
+        if (head - tail >= TRACE_ENTRIES) {
+            continue ; // slot reused during the copy, resync on the next pass
+        }
+
+        printf("%10u %03o %c %06o %06o\n", e.us, e.addr, e.dir, e.value, e.csr) ;
+        tail++ ;
+    }
+
+    return (int32_t)(dump_end - tail) > 0 ;
+}
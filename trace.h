@@ -0,0 +1,30 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include "pico/types.h"
+
+#ifndef TRACE_ENTRIES
+#define TRACE_ENTRIES 256 // power of 2
+#endif
+
+#define TRACE_READ  'R'
+#define TRACE_WRITE 'W'
+#define TRACE_RESET 'Z'
+
+typedef struct {
+    uint32_t us ;
+    uint8_t  addr ;
+    uint8_t  dir ;
+    uint16_t value ;
+    uint16_t csr ;   // device status after the transaction
+} TRACE_ENTRY ;
+
+// called from the I2C IRQ only (single producer)
+void trace_record(uint8_t addr, uint8_t dir, uint16_t value, uint16_t csr) ;
+
+// dump the ring to stdio a few lines per call, without stopping the emulator;
+// trace_dump_step returns true while lines remain
+void trace_dump_start() ;
+bool trace_dump_step() ;
+
+#endif